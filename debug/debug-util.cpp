@@ -56,6 +56,10 @@ void ClassicStringPayload::fill(size_t len) {
 
 payloadType IntPayload::_staticType;
 
+payloadType GeoPayload::_staticType;
+
+payloadType VectorPayload::_staticType;
+
 bool IntPayloadFilter::match(const udbgraph::Payload * const pl) const noexcept {
 	// do not throw std::bad_cast on failure because that payload belongs
 	// to an other graph elem
@@ -104,6 +104,88 @@ public:
 	virtual bool match(const udbgraph::Payload * const pl) const noexcept;
 };
 
+/** Node payload holding a position in degrees. */
+class GeoPayload : public udbgraph::Payload {
+protected:
+	static udbgraph::payloadType _staticType;
+
+	double latitude = 0.0;
+
+	double longitude = 0.0;
+
+public:
+    /** Sets type for instance. */
+    GeoPayload(udbgraph::payloadType pt) : Payload(pt) {}
+    
+	~GeoPayload() {}
+
+	/** Static PayloadType ID for GEFactory. */
+	static udbgraph::payloadType id() { return _staticType; }
+
+	/** Sets the static PayloadType ID for GEFactory. */
+	static void setID(udbgraph::payloadType pt) { _staticType = pt; }
+
+	/** Used in GEFactory to create a shared_ptr holding a new class instance. */
+	static std::shared_ptr<udbgraph::GraphElem> create(std::shared_ptr<udbgraph::Database> &db, udbgraph::payloadType pt) {
+		return std::shared_ptr<udbgraph::GraphElem>(new udbgraph::Node(db, std::unique_ptr<udbgraph::Payload>(new GeoPayload(pt))));
+	}
+
+	void set(double lat, double lon) { latitude = lat; longitude = lon; }
+
+	double getLatitude() const { return latitude; }
+
+	double getLongitude() const { return longitude; }
+
+	virtual void serialize(udbgraph::Converter &conv) const { conv << latitude << longitude; }
+
+	virtual void deserialize(udbgraph::Converter &conv) { conv >> latitude >> longitude; }
+};
+
+/** Node payload holding an embedding vector. */
+class VectorPayload : public udbgraph::Payload {
+protected:
+	static udbgraph::payloadType _staticType;
+
+	std::vector<float> content;
+
+public:
+    /** Sets type for instance. */
+    VectorPayload(udbgraph::payloadType pt) : Payload(pt) {}
+    
+	~VectorPayload() {}
+
+	/** Static PayloadType ID for GEFactory. */
+	static udbgraph::payloadType id() { return _staticType; }
+
+	/** Sets the static PayloadType ID for GEFactory. */
+	static void setID(udbgraph::payloadType pt) { _staticType = pt; }
+
+	/** Used in GEFactory to create a shared_ptr holding a new class instance. */
+	static std::shared_ptr<udbgraph::GraphElem> create(std::shared_ptr<udbgraph::Database> &db, udbgraph::payloadType pt) {
+		return std::shared_ptr<udbgraph::GraphElem>(new udbgraph::Node(db, std::unique_ptr<udbgraph::Payload>(new VectorPayload(pt))));
+	}
+
+	void set(const std::vector<float> &v) { content = v; }
+
+	const std::vector<float>& get() const { return content; }
+
+	virtual void serialize(udbgraph::Converter &conv) const {
+		conv << static_cast<uint32_t>(content.size());
+		for(float f : content) {
+			conv << f;
+		}
+	}
+
+	virtual void deserialize(udbgraph::Converter &conv) {
+		uint32_t size;
+		conv >> size;
+		content.resize(size);
+		for(uint32_t i = 0; i < size; i++) {
+			conv >> content[i];
+		}
+	}
+};
+
 class StringInFile {
 	std::ifstream ifs;
 	std::streamsize bufLen;
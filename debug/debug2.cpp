@@ -13,6 +13,9 @@ TODO:
 #include<csignal>
 #include<cstring>
 #include<iostream>
+#include<algorithm>
+#include<cmath>
+#include<thread>
 #include"udbgraph.h"
 #include"debug-util.h"
 
@@ -645,6 +648,1594 @@ void testEdgeUpdate() {
 	}
 }
 
+void testEdgesBetween() {
+	try {
+		shared_ptr<GraphElem> node1, node2, node3, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		node3 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node3, tr);
+		// two directed edges from node1 to node2, one back and one undirected
+		edge = GEFactory::create(db, IntPayload::id());
+		dynamic_cast<IntPayload*>(edge->pl())->set(1);
+		edge->setEnds(node1, node2);
+		db->write(edge, tr);
+		edge = GEFactory::create(db, IntPayload::id());
+		dynamic_cast<IntPayload*>(edge->pl())->set(2);
+		edge->setEnds(node1, node2);
+		db->write(edge, tr);
+		edge = GEFactory::create(db, IntPayload::id());
+		dynamic_cast<IntPayload*>(edge->pl())->set(3);
+		edge->setEnds(node2, node1);
+		db->write(edge, tr);
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		edge->setEnds(node2, node1);
+		db->write(edge, tr);
+		tr.commit();
+		tr = db->beginTrans(TT::RO);
+		QueryResult result;
+		int cnt;
+		node1->getEdgesBetween(result, node2, EdgeEndType::Out, Filter::allpass(), tr);
+		if((cnt = result.size()) != 2) {
+			cout << "testEdgesBetween 1: wrong number of outgoing edges: " << cnt << endl;
+		}
+		result.clear();
+		node1->getEdgesBetween(result, node2, EdgeEndType::In, Filter::allpass(), tr);
+		if((cnt = result.size()) != 1) {
+			cout << "testEdgesBetween 2: wrong number of incoming edges: " << cnt << endl;
+		}
+		result.clear();
+		node1->getEdgesBetween(result, node2, EdgeEndType::Un, Filter::allpass(), tr);
+		if((cnt = result.size()) != 1) {
+			cout << "testEdgesBetween 3: wrong number of undirected edges: " << cnt << endl;
+		}
+		result.clear();
+		node2->getEdgesBetween(result, node1, EdgeEndType::Any, Filter::allpass(), tr);
+		if((cnt = result.size()) != 4) {
+			cout << "testEdgesBetween 4: wrong number of all edges: " << cnt << endl;
+		}
+		result.clear();
+		IntPayloadFilter ipf(2);
+		node1->getEdgesBetween(result, node2, EdgeEndType::Out, ipf, tr);
+		if((cnt = result.size()) != 1) {
+			cout << "testEdgesBetween 5: wrong number of filtered edges: " << cnt << endl;
+		}
+		result.clear();
+		if(!node2->existsEdge(node1, EdgeEndType::Un, tr)) {
+			cout << "testEdgesBetween 6: undirected edge not found." << endl;
+		}
+		if(node1->existsEdge(node3, EdgeEndType::Any, tr) || node3->existsEdge(node2, EdgeEndType::Any, tr)) {
+			cout << "testEdgesBetween 7: non-existent edge found." << endl;
+		}
+		tr.commit();
+		if(!node1->existsEdge(node2, EdgeEndType::In)) {
+			cout << "testEdgesBetween 8: incoming edge not found." << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		node2->attach(tr);
+		Transaction trr = db->beginTrans(TT::RO);
+		try {
+			node1->existsEdge(node2, EdgeEndType::Any, trr);
+			cout << "testEdgesBetween 9: no exception for node in a read-write transaction." << endl;
+		}
+		catch(TransactionException &e) {
+		}
+		trr.commit();
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testEdgesBetween: " << e.what() << endl;
+	}
+}
+
+void testDegree() {
+	try {
+		shared_ptr<GraphElem> node1, node2, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		for(int i = 0; i < 30; i++) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+			edge->setEnds(node1, node2);
+			db->write(edge, tr);
+		}
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		edge->setEnds(node1, node2);
+		db->write(edge, tr);
+		// the own transaction sees its changes
+		countType cnt;
+		if((cnt = node1->getDegree(EdgeEndType::Out, tr)) != 30) {
+			cout << "testDegree 1: wrong out degree in transaction: " << cnt << endl;
+		}
+		tr.commit();
+		if((cnt = node1->getDegree(EdgeEndType::Any)) != 31) {
+			cout << "testDegree 2: wrong degree: " << cnt << endl;
+		}
+		if((cnt = node2->getDegree(EdgeEndType::Out)) != 0) {
+			cout << "testDegree 3: wrong out degree: " << cnt << endl;
+		}
+		deque<shared_ptr<GraphElem>> nodes;
+		nodes.push_back(node2);
+		nodes.push_back(node1);
+		deque<countType> degrees = db->getDegrees(nodes, EdgeEndType::In);
+		if(degrees[0] != 30 || degrees[1] != 0) {
+			cout << "testDegree 4: wrong in degrees: " << degrees[0] << " " << degrees[1] << endl;
+		}
+		degrees = db->getDegrees(nodes, EdgeEndType::Un);
+		if(degrees[0] != 1 || degrees[1] != 1) {
+			cout << "testDegree 5: wrong undirected degrees: " << degrees[0] << " " << degrees[1] << endl;
+		}
+		try {
+			edge->getDegree(EdgeEndType::Any);
+			cout << "testDegree 6: no exception for edge." << endl;
+		}
+		catch(IllegalMethodException &e) {
+		}
+	}
+	catch(exception &e) {
+		cout << "testDegree: " << e.what() << endl;
+	}
+}
+
+void testTypedEdges() {
+	try {
+		shared_ptr<GraphElem> node1, node2, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		for(int i = 0; i < 10; i++) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+			edge->setEnds(node1, node2);
+			db->write(edge, tr);
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+			edge->setEnds(node1, node2);
+			db->write(edge, tr);
+		}
+		for(int i = 0; i < 3; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(i);
+			edge->setEnds(node2, node1);
+			db->write(edge, tr);
+		}
+		QueryResult result;
+		int cnt;
+		// uncommitted edges must be found as well
+		node1->getEdges(result, EdgeEndType::In, PayloadTypeFilter::get(IntPayload::id()), tr);
+		if((cnt = result.size()) != 3) {
+			cout << "testTypedEdges 1: wrong number of typed edges in transaction: " << cnt << endl;
+		}
+		result.clear();
+		tr.commit();
+		node1->getEdges(result, EdgeEndType::Any, PayloadTypeFilter::get(IntPayload::id()));
+		if((cnt = result.size()) != 3) {
+			cout << "testTypedEdges 2: wrong number of typed edges: " << cnt << endl;
+		}
+		result.clear();
+		node1->getEdges(result, EdgeEndType::Out, PayloadTypeFilter::get(IntPayload::id()));
+		if((cnt = result.size()) != 0) {
+			cout << "testTypedEdges 3: wrong number of typed edges: " << cnt << endl;
+		}
+		result.clear();
+		node2->getEdges(result, EdgeEndType::Un, PayloadTypeFilter::get(PT_EMPTY_UEDGE));
+		if((cnt = result.size()) != 10) {
+			cout << "testTypedEdges 4: wrong number of undirected edges: " << cnt << endl;
+		}
+		result.clear();
+		node2->getEdges(result, EdgeEndType::Any, PayloadTypeFilter::get(PT_EMPTY_DEDGE));
+		if((cnt = result.size()) != 10) {
+			cout << "testTypedEdges 5: wrong number of directed edges: " << cnt << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testTypedEdges: " << e.what() << endl;
+	}
+}
+
+void testNeighbours() {
+	try {
+		shared_ptr<GraphElem> node1, node2, node3, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, ClassicStringPayload::id());
+		dynamic_cast<ClassicStringPayload*>(node2->pl())->set("neighbour");
+		db->write(node2, tr);
+		node3 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node3, tr);
+		// two parallel edges to node2, one undirected to node3 and one from root
+		for(int i = 0; i < 2; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(i);
+			edge->setEnds(node1, node2);
+			db->write(edge, tr);
+		}
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		edge->setEnds(node3, node1);
+		db->write(edge, tr);
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setStartRootEnd(node1);
+		db->write(edge, tr);
+		tr.commit();
+		QueryResult result;
+		int cnt;
+		node1->getNeighbours(result, EdgeEndType::Any, Filter::allpass(), Filter::allpass());
+		if((cnt = result.size()) != 2) {
+			cout << "testNeighbours 1: wrong number of neighbours: " << cnt << endl;
+		}
+		result.clear();
+		node1->getNeighbours(result, EdgeEndType::Un, PayloadTypeFilter::get(PT_EMPTY_UEDGE), Filter::allpass());
+		if((cnt = result.size()) != 1 || (*result.begin())->getKey() != node3->getKey()) {
+			cout << "testNeighbours 2: wrong undirected neighbours: " << cnt << endl;
+		}
+		result.clear();
+		IntPayloadFilter ipf(1);
+		node1->getNeighbours(result, EdgeEndType::Out, ipf, Filter::allpass());
+		if((cnt = result.size()) != 1 || (*result.begin())->getKey() != node2->getKey()) {
+			cout << "testNeighbours 3: wrong neighbours by edge content: " << cnt << endl;
+		}
+		result.clear();
+		node1->getNeighbours(result, EdgeEndType::Any, Filter::allpass(), PayloadTypeFilter::get(PT_EMPTY_NODE));
+		if((cnt = result.size()) != 1 || (*result.begin())->getKey() != node3->getKey()) {
+			cout << "testNeighbours 4: wrong neighbours by node type: " << cnt << endl;
+		}
+		result.clear();
+		node2->getNeighbours(result, EdgeEndType::In, Filter::allpass(), Filter::allpass());
+		if((cnt = result.size()) != 1) {
+			cout << "testNeighbours 5: wrong number of incoming neighbours: " << cnt << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testNeighbours: " << e.what() << endl;
+	}
+}
+
+void testBulkEdges() {
+	try {
+		shared_ptr<GraphElem> hub, leaf, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		deque<shared_ptr<GraphElem>> elems;
+		hub = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(hub, tr);
+		leaf = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(leaf, tr);
+		// the empty hash tables must grow to their final size at once
+		for(int i = 0; i < 1500; i++) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+			edge->setEnds(hub, leaf);
+			elems.push_back(edge);
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+			edge->setEnds(leaf, hub);
+			elems.push_back(edge);
+		}
+		db->write(elems, tr);
+		tr.commit();
+		countType cnt;
+		if((cnt = hub->getDegree(EdgeEndType::Out)) != 1500) {
+			cout << "testBulkEdges 1: wrong out degree: " << cnt << endl;
+		}
+		QueryResult result;
+		hub->getEdges(result, EdgeEndType::Un, Filter::allpass());
+		if((cnt = result.size()) != 1500) {
+			cout << "testBulkEdges 2: wrong number of undirected edges: " << cnt << endl;
+		}
+		result.clear();
+		// a second bulk and a single write on the now large tables
+		elems.clear();
+		for(int i = 0; i < 700; i++) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+			edge->setEnds(leaf, hub);
+			elems.push_back(edge);
+		}
+		db->write(elems);
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setEnds(leaf, hub);
+		db->write(edge);
+		hub->getEdges(result, EdgeEndType::In, Filter::allpass());
+		if((cnt = result.size()) != 701) {
+			cout << "testBulkEdges 3: wrong number of incoming edges: " << cnt << endl;
+		}
+		result.clear();
+		leaf->getEdges(result, EdgeEndType::Any, Filter::allpass());
+		if((cnt = result.size()) != 3701) {
+			cout << "testBulkEdges 4: wrong number of all edges: " << cnt << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testBulkEdges: " << e.what() << endl;
+	}
+}
+
+void testEdgeCursor() {
+	try {
+		shared_ptr<GraphElem> node1, node2, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		for(int i = 0; i < 50; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(i);
+			edge->setEnds(node1, node2);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		tr = db->beginTrans(TT::RO);
+		EdgeCursor cursor = node1->getEdgeCursor(EdgeEndType::Out, Filter::allpass(), tr, 5);
+		int cnt = 0;
+		while(cursor.next()) {
+			cnt++;
+		}
+		if(cnt != 5) {
+			cout << "testEdgeCursor 1: wrong number of edges with limit: " << cnt << endl;
+		}
+		IntPayloadFilter ipf(17);
+		EdgeCursor filtered = node2->getEdgeCursor(EdgeEndType::In, ipf, tr);
+		edge = filtered.next();
+		if(!edge || dynamic_cast<IntPayload*>(edge->pl())->get() != 17 || filtered.next()) {
+			cout << "testEdgeCursor 2: filtered cursor failed." << endl;
+		}
+		if(!node1->getFirstEdge(EdgeEndType::Any, PayloadTypeFilter::get(IntPayload::id()), tr)) {
+			cout << "testEdgeCursor 3: first edge not found." << endl;
+		}
+		if(node1->getFirstEdge(EdgeEndType::In, Filter::allpass(), tr)) {
+			cout << "testEdgeCursor 4: non-existent first edge found." << endl;
+		}
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testEdgeCursor: " << e.what() << endl;
+	}
+}
+
+/** Accepts edges ending in the given node using only the head record. */
+class EndFilter : public Filter {
+protected:
+	keyType endKey;
+
+public:
+	EndFilter(keyType k) noexcept : endKey(k) {}
+
+	virtual bool matchHead(const HeadFields &head) const noexcept { return head.end == endKey; }
+};
+
+void testHeadFilter() {
+	try {
+		shared_ptr<GraphElem> node1, node2, node3, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		node3 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node3, tr);
+		for(int i = 0; i < 6; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(i);
+			edge->setEnds(node1, i % 3 == 0 ? node2 : node3);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		QueryResult result;
+		int cnt;
+		EndFilter ef(node2->getKey());
+		node1->getEdges(result, EdgeEndType::Out, ef);
+		if((cnt = result.size()) != 2) {
+			cout << "testHeadFilter 1: wrong number of edges: " << cnt << endl;
+		}
+		for(auto &e : result) {
+			if(dynamic_cast<IntPayload*>(e->pl())->get() % 3 != 0) {
+				cout << "testHeadFilter 2: wrong edge returned." << endl;
+			}
+		}
+		result.clear();
+		// the node filter works on the head as well
+		node1->getNeighbours(result, EdgeEndType::Out, PayloadTypeFilter::get(IntPayload::id()), PayloadTypeFilter::get(PT_EMPTY_NODE));
+		if((cnt = result.size()) != 2) {
+			cout << "testHeadFilter 3: wrong number of neighbours: " << cnt << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testHeadFilter: " << e.what() << endl;
+	}
+}
+
+void testTraversal() {
+	try {
+		shared_ptr<GraphElem> nodes[5], edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 5; i++) {
+			nodes[i] = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+			db->write(nodes[i], tr);
+		}
+		// root -> 0 -> 1 -> 2, 0 -> 3 -> 2, 3 -> 0 back, 2 - 4 undirected
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setStartRootEnd(nodes[0]);
+		db->write(edge, tr);
+		int ends[][2] = { {0, 1}, {1, 2}, {0, 3}, {3, 2}, {3, 0} };
+		for(auto &e : ends) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+			edge->setEnds(nodes[e[0]], nodes[e[1]]);
+			db->write(edge, tr);
+		}
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		edge->setEnds(nodes[2], nodes[4]);
+		db->write(edge, tr);
+		tr.commit();
+		deque<Hop> hops;
+		for(int i = 0; i < 3; i++) {
+			hops.push_back(Hop(EdgeEndType::Out, Filter::allpass(), Filter::allpass()));
+		}
+		deque<QueryResult> levels;
+		nodes[0]->traverse(levels, hops);
+		if(levels.size() != 2 || levels[0].size() != 2 || levels[1].size() != 1 || (*levels[1].begin())->getKey() != nodes[2]->getKey()) {
+			cout << "testTraversal 1: wrong levels: " << levels.size() << endl;
+		}
+		hops.clear();
+		hops.push_back(Hop(EdgeEndType::Out, Filter::allpass(), Filter::allpass()));
+		hops.push_back(Hop(EdgeEndType::Out, Filter::allpass(), Filter::allpass()));
+		hops.push_back(Hop(EdgeEndType::Out, Filter::allpass(), Filter::allpass()));
+		hops.push_back(Hop(EdgeEndType::Any, PayloadTypeFilter::get(PT_EMPTY_UEDGE), Filter::allpass()));
+		levels.clear();
+		db->traverseFromRoot(levels, hops);
+		if(levels.size() != 4 || levels[0].size() != 1 || levels[3].size() != 1 || (*levels[3].begin())->getKey() != nodes[4]->getKey()) {
+			cout << "testTraversal 2: wrong levels from root: " << levels.size() << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testTraversal: " << e.what() << endl;
+	}
+}
+
+void testParallelRead() {
+	try {
+		shared_ptr<GraphElem> hub, node, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		db->setWorkerThreads(4);
+		Transaction tr = db->beginTrans(TT::RW);
+		hub = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(hub, tr);
+		for(int i = 0; i < 100; i++) {
+			node = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+			db->write(node, tr);
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(i % 2);
+			edge->setEnds(hub, node);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		QueryResult result;
+		int cnt;
+		IntPayloadFilter ipf(1);
+		hub->getEdges(result, EdgeEndType::Out, ipf);
+		if((cnt = result.size()) != 50) {
+			cout << "testParallelRead 1: wrong number of edges: " << cnt << endl;
+		}
+		result.clear();
+		hub->getNeighbours(result, EdgeEndType::Out, ipf, Filter::allpass());
+		if((cnt = result.size()) != 50) {
+			cout << "testParallelRead 2: wrong number of neighbours: " << cnt << endl;
+		}
+		deque<Hop> hops;
+		hops.push_back(Hop(EdgeEndType::Out, Filter::allpass(), Filter::allpass()));
+		deque<QueryResult> levels;
+		hub->traverse(levels, hops);
+		if(levels.size() != 1 || (cnt = levels[0].size()) != 100) {
+			cout << "testParallelRead 3: wrong traversal result" << endl;
+		}
+		db->setWorkerThreads(1);
+	}
+	catch(exception &e) {
+		cout << "testParallelRead: " << e.what() << endl;
+	}
+}
+
+class IntWeight : public EdgeWeight {
+public:
+	virtual double weight(const Payload * const pl) const {
+		const IntPayload *ip = dynamic_cast<const IntPayload*>(pl);
+		return ip == nullptr ? 1.0 : ip->get();
+	}
+};
+
+void testShortestPath() {
+	try {
+		shared_ptr<GraphElem> nodes[5], edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 5; i++) {
+			nodes[i] = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+			db->write(nodes[i], tr);
+		}
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setStartRootEnd(nodes[0]);
+		db->write(edge, tr);
+		// 0 -10-> 4 directly, 0 -1-> 1 -1-> 2 -1-> 3 -1-> 4 around
+		int ends[][3] = { {0, 4, 10}, {0, 1, 1}, {1, 2, 1}, {2, 3, 1}, {3, 4, 1} };
+		for(auto &e : ends) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(e[2]);
+			edge->setEnds(nodes[e[0]], nodes[e[1]]);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		deque<shared_ptr<GraphElem>> path;
+		IntWeight iw;
+		double weight = nodes[0]->getShortestPath(path, nodes[4], EdgeEndType::Out, Filter::allpass(), iw);
+		if(weight != 4.0 || path.size() != 9 || path[2]->getKey() != nodes[1]->getKey()) {
+			cout << "testShortestPath 1: wrong weighted path: " << weight << endl;
+		}
+		path.clear();
+		size_t hops = nodes[0]->getFewestHopsPath(path, nodes[4], EdgeEndType::Out, Filter::allpass());
+		if(hops != 1 || path.size() != 3 || path[2]->getKey() != nodes[4]->getKey()) {
+			cout << "testShortestPath 2: wrong unweighted path: " << hops << endl;
+		}
+		path.clear();
+		IntPayloadFilter ipf(1);
+		hops = nodes[0]->getFewestHopsPath(path, nodes[4], EdgeEndType::Out, ipf);
+		if(hops != 4 || path.size() != 9) {
+			cout << "testShortestPath 3: wrong filtered path: " << hops << endl;
+		}
+		path.clear();
+		hops = nodes[4]->getFewestHopsPath(path, nodes[0], EdgeEndType::Out, Filter::allpass());
+		if(hops != GraphElem::NO_PATH || path.size() != 0) {
+			cout << "testShortestPath 4: path against edge direction: " << hops << endl;
+		}
+		path.clear();
+		hops = nodes[4]->getFewestHopsPath(path, nodes[4], EdgeEndType::Out, Filter::allpass());
+		if(hops != 0 || path.size() != 1) {
+			cout << "testShortestPath 5: wrong path to itself: " << hops << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testShortestPath: " << e.what() << endl;
+	}
+}
+
+void testPattern() {
+	try {
+		shared_ptr<GraphElem> nodes[4], edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 4; i++) {
+			nodes[i] = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+			db->write(nodes[i], tr);
+		}
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setStartRootEnd(nodes[0]);
+		db->write(edge, tr);
+		// triangle 0 -> 1 -> 2 -> 0 and 0 -> 3
+		int ends[][2] = { {0, 1}, {1, 2}, {2, 0}, {0, 3} };
+		for(auto &e : ends) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+			edge->setEnds(nodes[e[0]], nodes[e[1]]);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		Pattern triangle;
+		for(int i = 0; i < 3; i++) {
+			triangle.addNode(Filter::allpass());
+		}
+		triangle.addEdge(0, 1, EdgeEndType::Out, Filter::allpass());
+		triangle.addEdge(1, 2, EdgeEndType::Out, Filter::allpass());
+		triangle.addEdge(0, 2, EdgeEndType::In, Filter::allpass());
+		deque<PatternMatch> result;
+		nodes[0]->matchPattern(result, triangle, 0);
+		if(result.size() != 1 || result[0].nodes[1]->getKey() != nodes[1]->getKey() || result[0].nodes[2]->getKey() != nodes[2]->getKey()) {
+			cout << "testPattern 1: wrong triangles: " << result.size() << endl;
+		}
+		Pattern star;
+		star.addNode(Filter::allpass());
+		star.addNode(Filter::allpass());
+		star.addNode(Filter::allpass());
+		star.addEdge(0, 1, EdgeEndType::Out, Filter::allpass());
+		star.addEdge(0, 2, EdgeEndType::Out, Filter::allpass());
+		result.clear();
+		nodes[0]->matchPattern(result, star, 0);
+		if(result.size() != 2) {
+			cout << "testPattern 2: wrong stars: " << result.size() << endl;
+		}
+		Pattern path;
+		path.addNode(Filter::allpass());
+		path.addNode(Filter::allpass());
+		path.addNode(Filter::allpass());
+		path.addEdge(0, 1, EdgeEndType::Out, Filter::allpass());
+		path.addEdge(1, 2, EdgeEndType::Out, Filter::allpass());
+		result.clear();
+		db->matchPatternFromRoot(result, path, 0);
+		if(result.size() != 2) {
+			cout << "testPattern 3: wrong paths from root: " << result.size() << endl;
+		}
+		result.clear();
+		nodes[3]->matchPattern(result, triangle, 0);
+		if(result.size() != 0) {
+			cout << "testPattern 4: triangle found at leaf: " << result.size() << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testPattern: " << e.what() << endl;
+	}
+}
+
+void testCSR() {
+	try {
+		shared_ptr<GraphElem> node1, node2, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setEnds(node1, node2);
+		db->write(edge, tr);
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		edge->setEnds(node1, node2);
+		db->write(edge, tr);
+		tr.commit();
+		db->setWorkerThreads(4);
+		CSRGraph csr;
+		db->buildCSR(csr, true);
+		db->setWorkerThreads(1);
+		size_t i1 = csr.findNode(node1->getKey());
+		size_t i2 = csr.findNode(node2->getKey());
+		if(i1 == csr.getNodeCount() || i2 == csr.getNodeCount() || csr.findNode(KEY_ROOT) == csr.getNodeCount()) {
+			cout << "testCSR 1: missing nodes" << endl;
+		}
+		else {
+			if(csr.offsets[i1 + 1] - csr.offsets[i1] != 2 || csr.targets[csr.offsets[i1]] != i2 || csr.targets[csr.offsets[i1] + 1] != i2) {
+				cout << "testCSR 2: wrong edges of node1" << endl;
+			}
+			if(csr.offsets[i2 + 1] - csr.offsets[i2] != 1 || csr.directed[csr.offsets[i2]] != 0 || csr.edgeTypes[csr.offsets[i2]] != PT_EMPTY_UEDGE) {
+				cout << "testCSR 3: wrong edges of node2" << endl;
+			}
+		}
+		tr = db->beginTrans(TT::RW);
+		try {
+			db->buildCSR(csr);
+			cout << "testCSR 4: no exception with an open read-write transaction" << endl;
+		}
+		catch(TransactionException &e) {
+		}
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testCSR: " << e.what() << endl;
+	}
+}
+
+class StringScoreSetter : public ScoreSetter {
+public:
+	virtual bool set(Payload * const pl, double value) const {
+		ClassicStringPayload *csp = dynamic_cast<ClassicStringPayload*>(pl);
+		if(csp == nullptr || value == 0.0) {
+			return false;
+		}
+		csp->set(to_string(static_cast<int>(value)).c_str());
+		return true;
+	}
+};
+
+void testAnalytics() {
+	try {
+		shared_ptr<GraphElem> nodes[3], edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 3; i++) {
+			nodes[i] = GEFactory::create(db, ClassicStringPayload::id());
+			db->write(nodes[i], tr);
+		}
+		// a separate undirected triangle
+		for(int i = 0; i < 3; i++) {
+			edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+			edge->setEnds(nodes[i], nodes[(i + 1) % 3]);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		db->setWorkerThreads(4);
+		CSRGraph csr;
+		db->buildCSR(csr);
+		size_t idx[3];
+		for(int i = 0; i < 3; i++) {
+			idx[i] = csr.findNode(nodes[i]->getKey());
+		}
+		vector<size_t> components;
+		db->connectedComponents(csr, components);
+		if(components[idx[0]] != components[idx[1]] || components[idx[0]] != components[idx[2]] ||
+				components[idx[0]] == components[csr.findNode(KEY_ROOT)]) {
+			cout << "testAnalytics 1: wrong components" << endl;
+		}
+		vector<double> values;
+		db->pageRank(csr, values);
+		double sum = 0.0;
+		for(double v : values) {
+			sum += v;
+		}
+		if(sum < 0.999 || sum > 1.001 || fabs(values[idx[0]] - values[idx[1]]) > 1e-9) {
+			cout << "testAnalytics 2: wrong page ranks: " << sum << endl;
+		}
+		db->degreeCentrality(csr, values, EdgeEndType::Un);
+		if(fabs(values[idx[0]] * (csr.getNodeCount() - 1) - 2.0) > 1e-9) {
+			cout << "testAnalytics 3: wrong degree centrality" << endl;
+		}
+		db->setWorkerThreads(1);
+		vector<double> scores(csr.getNodeCount(), 0.0);
+		scores[idx[1]] = 42.0;
+		StringScoreSetter setter;
+		size_t committed;
+		db->writeScores(csr, scores, setter, 2, &committed);
+		if(committed != csr.getNodeCount()) {
+			cout << "testAnalytics 5: wrong committed count " << committed << endl;
+		}
+		QueryResult result;
+		nodes[0]->getNeighbours(result, EdgeEndType::Un, Filter::allpass(), Filter::allpass());
+		for(auto &read : result) {
+			if(read->getKey() == nodes[1]->getKey() && string(dynamic_cast<ClassicStringPayload*>(read->pl())->get()) != "42") {
+				cout << "testAnalytics 4: score not written" << endl;
+			}
+		}
+		// the analytics use the worker threads without the database mutex
+		db->setWorkerThreads(4);
+		vector<double> expected, ranks;
+		db->pageRank(csr, expected);
+		thread ranker([db, &csr, &ranks]() {
+			for(int i = 0; i < 20; i++) {
+				db->pageRank(csr, ranks);
+			}
+		});
+		for(int i = 0; i < 20; i++) {
+			result.clear();
+			nodes[0]->getNeighbours(result, EdgeEndType::Un, Filter::allpass(), Filter::allpass());
+			db->setWorkerThreads(i % 2 == 0 ? 2 : 4);
+		}
+		ranker.join();
+		if(result.size() != 2 || fabs(ranks[idx[0]] - expected[idx[0]]) > 1e-9) {
+			cout << "testAnalytics 6: wrong results of concurrent use" << endl;
+		}
+		db->setWorkerThreads(1);
+	}
+	catch(exception &e) {
+		cout << "testAnalytics: " << e.what() << endl;
+	}
+}
+
+void testOrphans() {
+	try {
+		shared_ptr<GraphElem> node1, node2, node3, edge1, edge2;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, ClassicStringPayload::id());
+		// long enough for continuation records
+		dynamic_cast<ClassicStringPayload*>(node1->pl())->fill(3000);
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		node3 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node3, tr);
+		edge1 = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge1->setEnds(node1, node2);
+		db->write(edge1, tr);
+		edge2 = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge2->setStartRootEnd(node3);
+		db->write(edge2, tr);
+		tr.commit();
+		OrphanReport report;
+		db->findOrphans(report);
+		auto contains = [](vector<keyType> &keys, keyType key) { return find(keys.begin(), keys.end(), key) != keys.end(); };
+		if(!contains(report.nodes, node1->getKey()) || !contains(report.nodes, node2->getKey()) ||
+				contains(report.nodes, node3->getKey()) || !contains(report.edges, edge1->getKey()) ||
+				contains(report.edges, edge2->getKey()) || report.strayRecords.size() != 0 || report.removed) {
+			cout << "testOrphans 1: wrong report" << endl;
+		}
+		db->findOrphans(report, true);
+		if(!report.removed) {
+			cout << "testOrphans 2: not removed" << endl;
+		}
+		db->findOrphans(report);
+		if(report.nodes.size() != 0 || report.edges.size() != 0 || report.strayRecords.size() != 0) {
+			cout << "testOrphans 3: orphans remained: " << report.nodes.size() << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		try {
+			db->findOrphans(report);
+			cout << "testOrphans 4: no exception with an open read-write transaction" << endl;
+		}
+		catch(TransactionException &e) {
+		}
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testOrphans: " << e.what() << endl;
+	}
+}
+
+class StringExtractor : public FieldExtractor {
+public:
+	virtual bool extract(const Payload * const pl, IndexKey &value) const {
+		value << string(dynamic_cast<const ClassicStringPayload*>(pl)->get());
+		return true;
+	}
+};
+
+class IntExtractor : public FieldExtractor {
+public:
+	virtual bool extract(const Payload * const pl, IndexKey &value) const {
+		value << static_cast<int32_t>(dynamic_cast<const IntPayload*>(pl)->get());
+		return true;
+	}
+};
+
+uint16_t stringIndex, intIndex;
+
+void testFieldIndex() {
+	try {
+		const char * const names[] = {"fieldtest-apple", "fieldtest-banana", "fieldtest-cherry", "fieldtest-apple"};
+		const int values[] = {-1000001, 1000003, 1000010};
+		shared_ptr<GraphElem> nodes[4], edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 4; i++) {
+			nodes[i] = GEFactory::create(db, ClassicStringPayload::id());
+			dynamic_cast<ClassicStringPayload*>(nodes[i]->pl())->set(names[i]);
+			db->write(nodes[i], tr);
+		}
+		for(int i = 0; i < 3; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(values[i]);
+			edge->setEnds(nodes[i], nodes[i + 1]);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		QueryResult res;
+		db->findByField(res, stringIndex, IndexKey() << string("fieldtest-apple"));
+		if(res.size() != 2) {
+			cout << "testFieldIndex 1: wrong count: " << res.size() << endl;
+		}
+		res.clear();
+		// a prefix of an indexed value must not match
+		db->findByField(res, stringIndex, IndexKey() << string("fieldtest-app"));
+		if(res.size() != 0) {
+			cout << "testFieldIndex 2: prefix matched: " << res.size() << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		dynamic_cast<ClassicStringPayload*>(nodes[3]->pl())->set("fieldtest-date");
+		db->write(nodes[3], tr);
+		tr.commit();
+		res.clear();
+		db->findByField(res, stringIndex, IndexKey() << string("fieldtest-apple"));
+		if(res.size() != 1 || res.count(nodes[0]) != 1) {
+			cout << "testFieldIndex 3: old value remained: " << res.size() << endl;
+		}
+		res.clear();
+		db->findByFieldRange(res, stringIndex, IndexKey() << string("fieldtest-banana"), IndexKey() << string("fieldtest-date"));
+		if(res.size() != 3 || res.count(nodes[0]) != 0) {
+			cout << "testFieldIndex 4: wrong range: " << res.size() << endl;
+		}
+		res.clear();
+		db->findByFieldRange(res, intIndex, IndexKey() << static_cast<int32_t>(-2000000), IndexKey() << static_cast<int32_t>(1000005));
+		if(res.size() != 2) {
+			cout << "testFieldIndex 5: wrong int range: " << res.size() << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		shared_ptr<GraphElem> node = GEFactory::create(db, ClassicStringPayload::id());
+		dynamic_cast<ClassicStringPayload*>(node->pl())->set("fieldtest-aborted");
+		db->write(node, tr);
+		res.clear();
+		db->findByField(res, stringIndex, IndexKey() << string("fieldtest-aborted"), tr);
+		if(res.size() != 1) {
+			cout << "testFieldIndex 6: not found in transaction: " << res.size() << endl;
+		}
+		tr.abort();
+		res.clear();
+		db->findByField(res, stringIndex, IndexKey() << string("fieldtest-aborted"));
+		if(res.size() != 0) {
+			cout << "testFieldIndex 7: aborted value found: " << res.size() << endl;
+		}
+		try {
+			db->findByField(res, 1000, IndexKey() << string("fieldtest-apple"));
+			cout << "testFieldIndex 8: no exception for unknown index" << endl;
+		}
+		catch(DatabaseException &e) {
+		}
+	}
+	catch(exception &e) {
+		cout << "testFieldIndex: " << e.what() << endl;
+	}
+}
+
+void testExtent() {
+	try {
+		shared_ptr<GraphElem> node1, node2, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		size_t before = db->countOfType(IntPayload::id());
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		for(int i = 0; i < 3; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(i);
+			edge->setEnds(node1, node2);
+			db->write(edge, tr);
+		}
+		tr.commit();
+		size_t after = db->countOfType(IntPayload::id());
+		if(after != before + 3) {
+			cout << "testExtent 1: wrong count: " << before << " " << after << endl;
+		}
+		map<payloadType, size_t> counts;
+		db->countTypes(counts);
+		if(counts[IntPayload::id()] != after || counts[ClassicStringPayload::id()] == 0) {
+			cout << "testExtent 2: wrong type counts" << endl;
+		}
+		tr = db->beginTrans(TT::RO);
+		ExtentCursor cursor = db->getExtentCursor(IntPayload::id(), Filter::allpass(), tr);
+		size_t found = 0;
+		keyType last = 0;
+		shared_ptr<GraphElem> ge;
+		while((ge = cursor.next())) {
+			if(ge->pl()->getType() != IntPayload::id() || ge->getKey() <= last) {
+				cout << "testExtent 3: wrong elem: " << ge->getKey() << endl;
+			}
+			last = ge->getKey();
+			found++;
+		}
+		if(found != after || last != edge->getKey()) {
+			cout << "testExtent 4: wrong enumeration: " << found << endl;
+		}
+		ExtentCursor limited = db->getExtentCursor(IntPayload::id(), Filter::allpass(), tr, 2);
+		found = 0;
+		while(limited.next()) {
+			found++;
+		}
+		if(found != 2) {
+			cout << "testExtent 5: limit not kept: " << found << endl;
+		}
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testExtent: " << e.what() << endl;
+	}
+}
+
+void testFieldCursor() {
+	try {
+		shared_ptr<GraphElem> node1, node2, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		node1 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node1, tr);
+		node2 = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(node2, tr);
+		deque<shared_ptr<GraphElem>> edges;
+		// more than one batch of the cursor
+		for(int i = 0; i < 300; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set(3000000 + (i * 7) % 300);
+			edge->setEnds(node1, node2);
+			edges.push_back(edge);
+		}
+		db->write(edges, tr);
+		tr.commit();
+		auto valueOf = [](shared_ptr<GraphElem> &ge) { return dynamic_cast<IntPayload*>(ge->pl())->get(); };
+		tr = db->beginTrans(TT::RO);
+		FieldCursor top = db->getFieldCursor(intIndex, FieldRange::all(true), Filter::allpass(), tr, 3);
+		int expected = 3000299;
+		shared_ptr<GraphElem> ge;
+		while((ge = top.next())) {
+			if(valueOf(ge) != expected--) {
+				cout << "testFieldCursor 1: wrong top value: " << valueOf(ge) << endl;
+			}
+		}
+		if(expected != 3000296) {
+			cout << "testFieldCursor 2: wrong top count" << endl;
+		}
+		FieldCursor all = db->getFieldCursor(intIndex, FieldRange::atLeast(IndexKey() << static_cast<int32_t>(3000000)), Filter::allpass(), tr);
+		expected = 3000000;
+		while((ge = all.next())) {
+			if(valueOf(ge) != expected++) {
+				cout << "testFieldCursor 3: wrong order: " << valueOf(ge) << endl;
+			}
+		}
+		if(expected != 3000300) {
+			cout << "testFieldCursor 4: wrong count: " << expected - 3000000 << endl;
+		}
+		FieldCursor between = db->getFieldCursor(intIndex, FieldRange::between(IndexKey() << static_cast<int32_t>(3000010),
+				IndexKey() << static_cast<int32_t>(3000012), true), Filter::allpass(), tr);
+		expected = 3000012;
+		while((ge = between.next())) {
+			if(valueOf(ge) != expected--) {
+				cout << "testFieldCursor 5: wrong value between: " << valueOf(ge) << endl;
+			}
+		}
+		if(expected != 3000009) {
+			cout << "testFieldCursor 6: wrong count between" << endl;
+		}
+		FieldCursor prefixed = db->getFieldCursor(stringIndex, FieldRange::startingWith("fieldtest-", true), Filter::allpass(), tr);
+		size_t count = 0;
+		while((ge = prefixed.next())) {
+			string value = dynamic_cast<ClassicStringPayload*>(ge->pl())->get();
+			if((count == 0 && value != "fieldtest-date") || value.compare(0, 10, "fieldtest-") != 0) {
+				cout << "testFieldCursor 7: wrong string: " << value << endl;
+			}
+			count++;
+		}
+		if(count != 4) {
+			cout << "testFieldCursor 8: wrong prefix count: " << count << endl;
+		}
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testFieldCursor: " << e.what() << endl;
+	}
+}
+
+void testExternalId() {
+	try {
+		shared_ptr<GraphElem> node1, node2, node3;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		node1 = GEFactory::create(db, ClassicStringPayload::id());
+		dynamic_cast<ClassicStringPayload*>(node1->pl())->set("external-v1");
+		if(db->upsertNode(IndexKey() << string("external-1"), node1)) {
+			cout << "testExternalId 1: new node reported as existing" << endl;
+		}
+		size_t count = db->countOfType(ClassicStringPayload::id());
+		node2 = GEFactory::create(db, ClassicStringPayload::id());
+		dynamic_cast<ClassicStringPayload*>(node2->pl())->set("external-v2");
+		Transaction tr = db->beginTrans(TT::RW);
+		if(!db->upsertNode(IndexKey() << string("external-1"), node2, tr) || node2->getKey() != node1->getKey()) {
+			cout << "testExternalId 2: existing node not updated" << endl;
+		}
+		node3 = GEFactory::create(db, ClassicStringPayload::id());
+		dynamic_cast<ClassicStringPayload*>(node3->pl())->set("external-v3");
+		db->upsertNode(IndexKey() << static_cast<uint64_t>(42), node3, tr);
+		tr.commit();
+		if(db->countOfType(ClassicStringPayload::id()) != count + 1) {
+			cout << "testExternalId 3: wrong node count" << endl;
+		}
+		QueryResult res;
+		db->findByField(res, stringIndex, IndexKey() << string("external-v1"));
+		if(res.size() != 0) {
+			cout << "testExternalId 4: old value indexed" << endl;
+		}
+		deque<IndexKey> ids;
+		ids.push_back(IndexKey() << string("external-1"));
+		ids.push_back(IndexKey() << string("external-unknown"));
+		ids.push_back(IndexKey() << static_cast<uint64_t>(42));
+		deque<keyType> keys;
+		db->lookupExternalIds(ids, keys);
+		if(keys.size() != 3 || keys[0] != node1->getKey() || keys[1] != KEY_INVALID || keys[2] != node3->getKey()) {
+			cout << "testExternalId 5: wrong lookup" << endl;
+		}
+		tr = db->beginTrans(TT::RO);
+		res.clear();
+		db->getNodesByExternalIds(res, ids, Filter::allpass(), tr);
+		if(res.size() != 2) {
+			cout << "testExternalId 6: wrong node count: " << res.size() << endl;
+		}
+		for(auto ge : res) {
+			string value = dynamic_cast<ClassicStringPayload*>(ge->pl())->get();
+			if(value != "external-v2" && value != "external-v3") {
+				cout << "testExternalId 7: wrong content: " << value << endl;
+			}
+		}
+		tr.commit();
+		shared_ptr<GraphElem> empty = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		try {
+			db->upsertNode(IndexKey() << string("external-1"), empty);
+			cout << "testExternalId 8: no exception for other payload type" << endl;
+		}
+		catch(IllegalArgumentException &e) {
+		}
+	}
+	catch(exception &e) {
+		cout << "testExternalId: " << e.what() << endl;
+	}
+}
+
+void testEdgeTypeExists() {
+	try {
+		shared_ptr<GraphElem> nodes[4], edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 4; i++) {
+			nodes[i] = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+			db->write(nodes[i], tr);
+		}
+		edge = GEFactory::create(db, IntPayload::id());
+		edge->setEnds(nodes[0], nodes[1]);
+		db->write(edge, tr);
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		edge->setEnds(nodes[0], nodes[2]);
+		db->write(edge, tr);
+		tr.commit();
+		if(!nodes[0]->existsEdgeOfType(EdgeEndType::Out, IntPayload::id()) || nodes[0]->existsEdgeOfType(EdgeEndType::In, IntPayload::id())) {
+			cout << "testEdgeTypeExists 1: wrong outgoing answer" << endl;
+		}
+		if(!nodes[1]->existsEdgeOfType(EdgeEndType::In, IntPayload::id()) || nodes[1]->existsEdgeOfType(EdgeEndType::Un, PT_ANY)) {
+			cout << "testEdgeTypeExists 2: wrong incoming answer" << endl;
+		}
+		tr = db->beginTrans(TT::RO);
+		if(nodes[0]->existsEdgeOfType(EdgeEndType::Any, payloadType(PT_EMPTY_DEDGE), tr) ||
+				!nodes[0]->existsEdgeOfType(EdgeEndType::Un, payloadType(PT_EMPTY_UEDGE), tr) ||
+				!nodes[2]->existsEdgeOfType(EdgeEndType::Any, PT_ANY, tr) || nodes[3]->existsEdgeOfType(EdgeEndType::Any, PT_ANY, tr)) {
+			cout << "testEdgeTypeExists 3: wrong answer" << endl;
+		}
+		tr.commit();
+		tr = db->beginTrans(TT::RW);
+		nodes[1]->attach(tr);
+		Transaction trr = db->beginTrans(TT::RO);
+		try {
+			nodes[1]->existsEdgeOfType(EdgeEndType::Any, PT_ANY, trr);
+			cout << "testEdgeTypeExists 4: no exception for node in a read-write transaction" << endl;
+		}
+		catch(TransactionException &e) {
+		}
+		trr.commit();
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testEdgeTypeExists: " << e.what() << endl;
+	}
+}
+
+class PositionExtractor : public GeoExtractor {
+public:
+	virtual bool extract(const Payload * const pl, double &latitude, double &longitude) const {
+		const GeoPayload * const gpl = dynamic_cast<const GeoPayload*>(pl);
+		latitude = gpl->getLatitude();
+		longitude = gpl->getLongitude();
+		return true;
+	}
+};
+
+uint16_t geoIndex;
+
+void testGeoIndex() {
+	try {
+		// Budapest, Vienna, Prague, Fiji (west of the antimeridian), Samoa (east of it)
+		const double positions[][2] = {{47.4979, 19.0402}, {48.2082, 16.3738}, {50.0755, 14.4378}, {-17.7134, 178.0650}, {-13.7590, -172.1046}};
+		shared_ptr<GraphElem> nodes[5];
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(int i = 0; i < 5; i++) {
+			nodes[i] = GEFactory::create(db, GeoPayload::id());
+			dynamic_cast<GeoPayload*>(nodes[i]->pl())->set(positions[i][0], positions[i][1]);
+			db->write(nodes[i], tr);
+		}
+		tr.commit();
+		QueryResult res;
+		db->findInBox(res, geoIndex, 45.0, 15.0, 49.0, 20.0);
+		if(res.size() != 2) {
+			cout << "testGeoIndex 1: box has " << res.size() << " elems instead of 2" << endl;
+		}
+		res.clear();
+		db->findInBox(res, geoIndex, -20.0, 170.0, -10.0, -170.0);
+		if(res.size() != 2) {
+			cout << "testGeoIndex 2: box crossing the antimeridian has " << res.size() << " elems instead of 2" << endl;
+		}
+		deque<shared_ptr<GraphElem>> nearest;
+		deque<double> distances;
+		db->findNearest(nearest, distances, geoIndex, 48.0, 17.0, 2);
+		if(nearest.size() != 2 || nearest[0]->getKey() != nodes[1]->getKey() || nearest[1]->getKey() != nodes[0]->getKey()) {
+			cout << "testGeoIndex 3: wrong nearest elems" << endl;
+		}
+		else if(distances[0] > distances[1] || distances[0] < 40000.0 || distances[0] > 60000.0) {
+			cout << "testGeoIndex 4: wrong distances " << distances[0] << " " << distances[1] << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		nodes[0]->attach(tr);
+		dynamic_cast<GeoPayload*>(nodes[0]->pl())->set(positions[2][0], positions[2][1]);
+		db->write(nodes[0], tr);
+		tr.commit();
+		res.clear();
+		db->findInBox(res, geoIndex, 45.0, 15.0, 49.0, 20.0);
+		if(res.size() != 1) {
+			cout << "testGeoIndex 5: box has " << res.size() << " elems after the move instead of 1" << endl;
+		}
+		try {
+			db->findInBox(res, geoIndex + 1, 45.0, 15.0, 49.0, 20.0);
+			cout << "testGeoIndex 6: no exception for unknown index" << endl;
+		}
+		catch(DatabaseException &e) {
+			checkException(e, "testGeoIndex 6", "Unknown spatial index");
+		}
+	}
+	catch(exception &e) {
+		cout << "testGeoIndex: " << e.what() << endl;
+	}
+}
+
+class EmbeddingExtractor : public VectorExtractor {
+public:
+	virtual bool extract(const Payload * const pl, vector<float> &vec) const {
+		vec = dynamic_cast<const VectorPayload*>(pl)->get();
+		return true;
+	}
+};
+
+uint16_t vectorIndex;
+
+void testVectorIndex() {
+	try {
+		const size_t count = 300, dim = 20, k = 10;
+		vector<vector<float>> vectors(count, vector<float>(dim));
+		uint32_t seed = 12345;
+		for(auto &vec : vectors) {
+			for(float &f : vec) {
+				seed = seed * 1103515245u + 12345u;
+				f = static_cast<float>((seed >> 8) % 10000) / 10000.0f;
+			}
+		}
+		deque<shared_ptr<GraphElem>> nodes;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		for(auto &vec : vectors) {
+			nodes.push_back(GEFactory::create(db, VectorPayload::id()));
+			dynamic_cast<VectorPayload*>(nodes.back()->pl())->set(vec);
+			db->write(nodes.back(), tr);
+		}
+		tr.commit();
+		deque<shared_ptr<GraphElem>> similar;
+		deque<double> distances;
+		vector<float> query = vectors[7];
+		query[0] += 0.001f;
+		db->findSimilar(similar, distances, vectorIndex, query, k);
+		if(similar.size() != k || similar[0]->getKey() != nodes[7]->getKey()) {
+			cout << "testVectorIndex 1: the nearest elem is not found" << endl;
+		}
+		// compare with exact search
+		vector<pair<float, keyType>> exact;
+		for(size_t i = 0; i < count; i++) {
+			exact.push_back(make_pair(VectorIndex::distance(VectorMetric::EUCLIDEAN, query.data(), vectors[i].data(), dim), nodes[i]->getKey()));
+		}
+		sort(exact.begin(), exact.end());
+		size_t hits = 0;
+		for(size_t i = 0; i < similar.size(); i++) {
+			for(size_t j = 0; j < k; j++) {
+				hits += similar[i]->getKey() == exact[j].second ? 1 : 0;
+			}
+			if(i > 0 && distances[i - 1] > distances[i]) {
+				cout << "testVectorIndex 2: distances are not ascending" << endl;
+			}
+		}
+		if(hits < k * 8 / 10) {
+			cout << "testVectorIndex 3: recall is " << hits << " of " << k << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		nodes[100]->attach(tr);
+		vector<float> moved(dim, 5.0f);
+		dynamic_cast<VectorPayload*>(nodes[100]->pl())->set(moved);
+		db->write(nodes[100], tr);
+		tr.commit();
+		similar.clear();
+		distances.clear();
+		db->findSimilar(similar, distances, vectorIndex, moved, 1);
+		if(similar.size() != 1 || similar[0]->getKey() != nodes[100]->getKey() || distances[0] != 0.0) {
+			cout << "testVectorIndex 4: the updated vector is not found" << endl;
+		}
+		similar.clear();
+		distances.clear();
+		db->findSimilar(similar, distances, vectorIndex, vectors[100], k, 100);
+		for(auto &ge : similar) {
+			if(ge->getKey() == nodes[100]->getKey()) {
+				cout << "testVectorIndex 5: the old vector is still indexed" << endl;
+			}
+		}
+		try {
+			db->findSimilar(similar, distances, vectorIndex, vector<float>(dim + 1), k);
+			cout << "testVectorIndex 6: no exception for wrong dimension" << endl;
+		}
+		catch(IllegalArgumentException &e) {
+			checkException(e, "testVectorIndex 6", "dimension");
+		}
+		// remove most vectors, the lists linking to them must be repaired
+		tr = db->beginTrans(TT::RW);
+		for(size_t i = 0; i < count; i++) {
+			if(i % 5 != 0) {
+				nodes[i]->attach(tr);
+				dynamic_cast<VectorPayload*>(nodes[i]->pl())->set(vector<float>());
+				db->write(nodes[i], tr);
+			}
+		}
+		tr.commit();
+		for(size_t i = 0; i < count; i += 5) {
+			if(i == 100) {
+				// moved above
+				continue;
+			}
+			similar.clear();
+			distances.clear();
+			db->findSimilar(similar, distances, vectorIndex, vectors[i], 1);
+			if(similar.size() != 1 || similar[0]->getKey() != nodes[i]->getKey()) {
+				cout << "testVectorIndex 7: a kept vector is not found after removals " << i << endl;
+			}
+		}
+	}
+	catch(exception &e) {
+		cout << "testVectorIndex: " << e.what() << endl;
+	}
+}
+
+uint16_t edgeOrder;
+
+void testEdgeOrder() {
+	try {
+		shared_ptr<GraphElem> hub, other, edge;
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		hub = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(hub, tr);
+		other = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(other, tr);
+		for(int i = 0; i < 30; i++) {
+			edge = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edge->pl())->set((i * 7) % 30);
+			if(i % 3 == 0) {
+				edge->setEnds(other, hub);
+			}
+			else {
+				edge->setEnds(hub, other);
+			}
+			db->write(edge, tr);
+		}
+		edge = GEFactory::create(db, payloadType(PT_EMPTY_DEDGE));
+		edge->setEnds(hub, other);
+		db->write(edge, tr);
+		tr.commit();
+		tr = db->beginTrans(TT::RO);
+		OrderedEdgeCursor latest = hub->getOrderedEdgeCursor(edgeOrder, EdgeEndType::Any, FieldRange::all(true), Filter::allpass(), tr, 5);
+		int expected = 29;
+		for(shared_ptr<GraphElem> ge = latest.next(); ge; ge = latest.next()) {
+			if(dynamic_cast<IntPayload*>(ge->pl())->get() != expected--) {
+				cout << "testEdgeOrder 1: wrong order at " << expected + 1 << endl;
+			}
+		}
+		if(expected != 24) {
+			cout << "testEdgeOrder 2: " << 29 - expected << " edges instead of 5" << endl;
+		}
+		OrderedEdgeCursor incoming = hub->getOrderedEdgeCursor(edgeOrder, EdgeEndType::In, FieldRange::atLeast(IndexKey() << static_cast<int32_t>(10)), Filter::allpass(), tr);
+		int count = 0, last = -1;
+		for(shared_ptr<GraphElem> ge = incoming.next(); ge; ge = incoming.next()) {
+			int value = dynamic_cast<IntPayload*>(ge->pl())->get();
+			if(value < 10 || value <= last || ge->getStart(tr)->getKey() != other->getKey()) {
+				cout << "testEdgeOrder 3: wrong edge with value " << value << endl;
+			}
+			last = value;
+			count++;
+		}
+		if(count != 6) {
+			cout << "testEdgeOrder 4: " << count << " incoming edges instead of 6" << endl;
+		}
+		try {
+			hub->getOrderedEdgeCursor(edgeOrder + 1, EdgeEndType::Any, FieldRange::all(), Filter::allpass(), tr);
+			cout << "testEdgeOrder 5: no exception for unknown index" << endl;
+		}
+		catch(DatabaseException &e) {
+			checkException(e, "testEdgeOrder 5", "Unknown edge order index");
+		}
+		tr.commit();
+	}
+	catch(exception &e) {
+		cout << "testEdgeOrder: " << e.what() << endl;
+	}
+}
+
+class IntValueExtractor : public ValueExtractor {
+public:
+	virtual bool extract(const Payload * const pl, double &value) const {
+		value = dynamic_cast<const IntPayload*>(pl)->get();
+		return true;
+	}
+};
+
+uint16_t intSum, undirCount;
+
+void testAggregate() {
+	try {
+		shared_ptr<GraphElem> a, b, edges[3];
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		a = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(a, tr);
+		b = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(b, tr);
+		for(int i = 0; i < 3; i++) {
+			edges[i] = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edges[i]->pl())->set(i + 1);
+			edges[i]->setEnds(a, b);
+			db->write(edges[i], tr);
+		}
+		shared_ptr<GraphElem> undir = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		undir->setEnds(a, b);
+		db->write(undir, tr);
+		tr.commit();
+		EdgeAggregate aggregate = a->getAggregate(intSum, EdgeEndType::Out);
+		if(aggregate.count != 3 || aggregate.sum != 6.0 || aggregate.average() != 2.0) {
+			cout << "testAggregate 1: wrong outgoing aggregate " << aggregate.count << " " << aggregate.sum << endl;
+		}
+		aggregate = b->getAggregate(intSum, EdgeEndType::In);
+		if(aggregate.count != 3 || aggregate.sum != 6.0 || b->getAggregate(intSum, EdgeEndType::Out).count != 0) {
+			cout << "testAggregate 2: wrong incoming aggregate " << aggregate.count << " " << aggregate.sum << endl;
+		}
+		if(b->getAggregate(undirCount, EdgeEndType::Any).count != 1 || a->getAggregate(undirCount, EdgeEndType::In).count != 0) {
+			cout << "testAggregate 3: wrong count of undirected edges" << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		edges[2]->attach(tr);
+		dynamic_cast<IntPayload*>(edges[2]->pl())->set(10);
+		db->write(edges[2], tr);
+		tr.commit();
+		aggregate = a->getAggregate(intSum, EdgeEndType::Any);
+		if(aggregate.count != 3 || aggregate.sum != 13.0) {
+			cout << "testAggregate 4: wrong aggregate after update " << aggregate.count << " " << aggregate.sum << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		shared_ptr<GraphElem> aborted = GEFactory::create(db, IntPayload::id());
+		dynamic_cast<IntPayload*>(aborted->pl())->set(100);
+		aborted->setEnds(a, b);
+		db->write(aborted, tr);
+		aggregate = a->getAggregate(intSum, EdgeEndType::Out, tr);
+		if(aggregate.count != 4 || aggregate.sum != 113.0) {
+			cout << "testAggregate 5: wrong aggregate inside the transaction " << aggregate.count << " " << aggregate.sum << endl;
+		}
+		tr.abort();
+		aggregate = a->getAggregate(intSum, EdgeEndType::Out);
+		if(aggregate.count != 3 || aggregate.sum != 13.0) {
+			cout << "testAggregate 6: wrong aggregate after abort " << aggregate.count << " " << aggregate.sum << endl;
+		}
+		try {
+			a->getAggregate(undirCount + 1, EdgeEndType::Any);
+			cout << "testAggregate 7: no exception for unknown index" << endl;
+		}
+		catch(DatabaseException &e) {
+			checkException(e, "testAggregate 7", "Unknown aggregate index");
+		}
+		tr = db->beginTrans(TT::RW);
+		a->attach(tr);
+		Transaction trr = db->beginTrans(TT::RO);
+		try {
+			a->getAggregate(intSum, EdgeEndType::Out, trr);
+			cout << "testAggregate 8: no exception for node in a read-write transaction" << endl;
+		}
+		catch(TransactionException &e) {
+		}
+		trr.commit();
+		tr.commit();
+		tr = db->beginTrans(TT::RW);
+		shared_ptr<GraphElem> c = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(c, tr);
+		shared_ptr<GraphElem> loop = GEFactory::create(db, IntPayload::id());
+		dynamic_cast<IntPayload*>(loop->pl())->set(5);
+		loop->setEnds(c, c);
+		db->write(loop, tr);
+		shared_ptr<GraphElem> undirLoop = GEFactory::create(db, payloadType(PT_EMPTY_UEDGE));
+		undirLoop->setEnds(c, c);
+		db->write(undirLoop, tr);
+		tr.commit();
+		aggregate = c->getAggregate(intSum, EdgeEndType::Any);
+		if(aggregate.count != c->getDegree(EdgeEndType::In) + c->getDegree(EdgeEndType::Out) || aggregate.sum != 10.0 ||
+				c->getAggregate(intSum, EdgeEndType::Out).count != 1) {
+			cout << "testAggregate 9: wrong aggregate of directed loop " << aggregate.count << " " << aggregate.sum << endl;
+		}
+		if(c->getAggregate(undirCount, EdgeEndType::Any).count != c->getDegree(EdgeEndType::Un)) {
+			cout << "testAggregate 10: wrong count of undirected loop" << endl;
+		}
+		tr = db->beginTrans(TT::RW);
+		loop->attach(tr);
+		dynamic_cast<IntPayload*>(loop->pl())->set(7);
+		db->write(loop, tr);
+		tr.commit();
+		aggregate = c->getAggregate(intSum, EdgeEndType::Any);
+		if(aggregate.count != 2 || aggregate.sum != 14.0) {
+			cout << "testAggregate 11: wrong aggregate of directed loop after update " << aggregate.count << " " << aggregate.sum << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testAggregate: " << e.what() << endl;
+	}
+}
+
+void testCountEdges() {
+	try {
+		shared_ptr<GraphElem> a, b, edges[4];
+		shared_ptr<Database> db = Database::newInstance(1, 1, "debug2");
+		db->open(mainFileName);
+		Transaction tr = db->beginTrans(TT::RW);
+		a = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(a, tr);
+		b = GEFactory::create(db, payloadType(PT_EMPTY_NODE));
+		db->write(b, tr);
+		for(int i = 0; i < 4; i++) {
+			edges[i] = GEFactory::create(db, IntPayload::id());
+			dynamic_cast<IntPayload*>(edges[i]->pl())->set(i % 2);
+			edges[i]->setEnds(a, b);
+			db->write(edges[i], tr);
+		}
+		tr.commit();
+		IntPayloadFilter ipf(1);
+		size_t count = a->countEdges(EdgeEndType::Out, ipf);
+		if(count != 2) {
+			cout << "testCountEdges 1: wrong count by payload " << count << endl;
+		}
+		count = b->countEdges(EdgeEndType::Any, PayloadTypeFilter::get(IntPayload::id()));
+		if(count != 4 || a->countEdges(EdgeEndType::In, PayloadTypeFilter::get(IntPayload::id())) != 0) {
+			cout << "testCountEdges 2: wrong count by type " << count << endl;
+		}
+		if(!b->anyEdge(EdgeEndType::In, ipf) || b->anyEdge(EdgeEndType::Out, ipf)) {
+			cout << "testCountEdges 3: wrong existence" << endl;
+		}
+		ipf.set(5);
+		if(a->anyEdge(EdgeEndType::Any, ipf)) {
+			cout << "testCountEdges 4: nonexistent edge found" << endl;
+		}
+		Transaction trr = db->beginTrans(TT::RO);
+		ipf.set(0);
+		count = a->countEdges(EdgeEndType::Out, ipf, trr);
+		Transaction trw = db->beginTrans(TT::RW);
+		try {
+			edges[1]->attach(trw);
+			dynamic_cast<IntPayload*>(edges[1]->pl())->set(0);
+			db->write(edges[1], trw);
+			trw.commit();
+		}
+		catch(TransactionException &e) {
+			cout << "testCountEdges 5: edge registered by count " << e.what() << endl;
+			trw.abort();
+		}
+		if(count != 2) {
+			cout << "testCountEdges 6: wrong count in transaction " << count << endl;
+		}
+		trr.commit();
+		count = a->countEdges(EdgeEndType::Out, ipf);
+		if(count != 3) {
+			cout << "testCountEdges 7: wrong count after update " << count << endl;
+		}
+	}
+	catch(exception &e) {
+		cout << "testCountEdges: " << e.what() << endl;
+	}
+}
+
 int main(int argc, char** argv) {
 #if USE_NVWA == 1
     nvwa::new_progname = argv[0];
@@ -653,6 +2244,15 @@ int main(int argc, char** argv) {
 	InitStatic globalStaticInitializer;
     ClassicStringPayload::setID(GEFactory::reg(ClassicStringPayload::create));
     IntPayload::setID(GEFactory::reg(IntPayload::create));
+    stringIndex = GEFactory::regIndex(ClassicStringPayload::id(), make_shared<StringExtractor>());
+    intIndex = GEFactory::regIndex(IntPayload::id(), make_shared<IntExtractor>());
+    GeoPayload::setID(GEFactory::reg(GeoPayload::create));
+    geoIndex = GEFactory::regGeoIndex(GeoPayload::id(), make_shared<PositionExtractor>());
+    VectorPayload::setID(GEFactory::reg(VectorPayload::create));
+    vectorIndex = GEFactory::regVectorIndex(VectorPayload::id(), make_shared<EmbeddingExtractor>());
+    edgeOrder = GEFactory::regEdgeOrder(IntPayload::id(), make_shared<IntExtractor>());
+    intSum = GEFactory::regAggregate(IntPayload::id(), make_shared<IntValueExtractor>());
+    undirCount = GEFactory::regAggregate(payloadType(PT_EMPTY_UEDGE), shared_ptr<ValueExtractor>());
     Database::setErrorHandler(udbgraphErrorHandler);
 	testNotReady();
 	testSingleInsertCreate();
@@ -668,6 +2268,30 @@ int main(int argc, char** argv) {
 	testPayloadManagement();
 	testMoreReadonly();
 	testEdgeUpdate();
+	testEdgesBetween();
+	testDegree();
+	testTypedEdges();
+	testNeighbours();
+	testBulkEdges();
+	testEdgeCursor();
+	testHeadFilter();
+	testTraversal();
+	testParallelRead();
+	testShortestPath();
+	testPattern();
+	testCSR();
+	testAnalytics();
+	testOrphans();
+	testFieldIndex();
+	testExtent();
+	testFieldCursor();
+	testExternalId();
+	testEdgeTypeExists();
+	testGeoIndex();
+	testVectorIndex();
+	testEdgeOrder();
+	testAggregate();
+	testCountEdges();
 	// cout << "After hash insert - insert: " << UpsCounter::getInsert() << "  erase: " << UpsCounter::getErase() << "  find: " << UpsCounter::getFind() << endl;
     return 0;
 }
@@ -0,0 +1,1377 @@
+/*
+COPYRIGHT COMES HERE
+*/
+
+#include<cstring>
+#include<cmath>
+#include<limits>
+#include<vector>
+#include<queue>
+#include<unordered_set>
+#include<algorithm>
+#include"udbgraph.h"
+
+#if USE_NVWA == 1
+#include"debug_new.h"
+#endif
+
+using namespace udbgraph;
+using namespace std;
+
+IndexKey& IndexKey::operator<<(uint8_t value) {
+    content.push_back(static_cast<char>(value));
+    return *this;
+}
+
+IndexKey& IndexKey::operator<<(uint32_t value) {
+    for(int i = sizeof(value) - 1; i >= 0; i--) {
+        content.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+    return *this;
+}
+
+IndexKey& IndexKey::operator<<(uint64_t value) {
+    for(int i = sizeof(value) - 1; i >= 0; i--) {
+        content.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+    return *this;
+}
+
+IndexKey& IndexKey::operator<<(int32_t value) {
+    return *this << static_cast<uint32_t>(static_cast<uint32_t>(value) ^ 0x80000000u);
+}
+
+IndexKey& IndexKey::operator<<(int64_t value) {
+    return *this << static_cast<uint64_t>(static_cast<uint64_t>(value) ^ 0x8000000000000000ull);
+}
+
+IndexKey& IndexKey::operator<<(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    // negative values have their order reversed, positive ones need the sign bit
+    bits = (bits & 0x8000000000000000ull) ? ~bits : bits | 0x8000000000000000ull;
+    return *this << bits;
+}
+
+IndexKey& IndexKey::operator<<(const string &value) {
+    content.append(value);
+    content.push_back('\0');
+    return *this;
+}
+
+IndexKey& IndexKey::append(const void * const data, size_t size) {
+    content.append(static_cast<const char*>(data), size);
+    return *this;
+}
+
+IndexKey IndexKey::successor() const {
+    string result(content);
+    while(result.size() > 0 && static_cast<uint8_t>(result.back()) == 0xff) {
+        result.pop_back();
+    }
+    if(result.size() > 0) {
+        result.back() = static_cast<char>(static_cast<uint8_t>(result.back()) + 1);
+    }
+    return IndexKey(result.data(), result.size());
+}
+
+uint8_t IndexKey::getUint8(size_t pos) const {
+    if(pos + sizeof(uint8_t) > content.size()) {
+        throw DebugException("IndexKey: position out of range.");
+    }
+    return static_cast<uint8_t>(content[pos]);
+}
+
+uint32_t IndexKey::getUint32(size_t pos) const {
+    if(pos + sizeof(uint32_t) > content.size()) {
+        throw DebugException("IndexKey: position out of range.");
+    }
+    uint32_t value = 0;
+    for(size_t i = 0; i < sizeof(value); i++) {
+        value = (value << 8) | static_cast<uint8_t>(content[pos + i]);
+    }
+    return value;
+}
+
+uint64_t IndexKey::getUint64(size_t pos) const {
+    if(pos + sizeof(uint64_t) > content.size()) {
+        throw DebugException("IndexKey: position out of range.");
+    }
+    uint64_t value = 0;
+    for(size_t i = 0; i < sizeof(value); i++) {
+        value = (value << 8) | static_cast<uint8_t>(content[pos + i]);
+    }
+    return value;
+}
+
+double IndexKey::getDouble(size_t pos) const {
+    uint64_t bits = getUint64(pos);
+    // inverse of operator<<(double)
+    bits = (bits & 0x8000000000000000ull) ? bits & ~0x8000000000000000ull : ~bits;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void Index::create(ups_env_t *env) {
+    // default parameters mean variable length binary keys and records
+    check(ups_env_create_db(env, &db, name, 0, nullptr));
+}
+
+bool Index::open(ups_env_t *env) {
+    ups_status_t st = ups_env_open_db(env, &db, name, 0, nullptr);
+    if(st == UPS_DATABASE_NOT_FOUND) {
+        db = nullptr;
+        return false;
+    }
+    check(st);
+    return true;
+}
+
+void Index::insert(const IndexKey &key, const IndexKey &record, ups_txn_t *tr) {
+    ups_key_t upsKey;
+    ups_record_t upsRecord;
+    memset(&upsKey, 0, sizeof(upsKey));
+    memset(&upsRecord, 0, sizeof(upsRecord));
+    upsKey.data = const_cast<void*>(key.data());
+    upsKey.size = static_cast<uint16_t>(key.size());
+    upsRecord.data = const_cast<void*>(record.data());
+    upsRecord.size = static_cast<uint32_t>(record.size());
+    check(_ups_db_insert(db, tr, &upsKey, &upsRecord, UPS_OVERWRITE));
+}
+
+void Index::insert(const IndexKey &key, ups_txn_t *tr) {
+    IndexKey empty;
+    insert(key, empty, tr);
+}
+
+bool Index::erase(const IndexKey &key, ups_txn_t *tr) {
+    ups_key_t upsKey;
+    memset(&upsKey, 0, sizeof(upsKey));
+    upsKey.data = const_cast<void*>(key.data());
+    upsKey.size = static_cast<uint16_t>(key.size());
+    ups_status_t st = _ups_db_erase(db, tr, &upsKey, 0);
+    if(st == UPS_KEY_NOT_FOUND) {
+        return false;
+    }
+    check(st);
+    return true;
+}
+
+bool Index::find(const IndexKey &key, IndexKey &record, ups_txn_t *tr) {
+    ups_key_t upsKey;
+    ups_record_t upsRecord;
+    memset(&upsKey, 0, sizeof(upsKey));
+    memset(&upsRecord, 0, sizeof(upsRecord));
+    upsKey.data = const_cast<void*>(key.data());
+    upsKey.size = static_cast<uint16_t>(key.size());
+    ups_status_t st = _ups_db_find(db, tr, &upsKey, &upsRecord, 0);
+    if(st == UPS_KEY_NOT_FOUND) {
+        return false;
+    }
+    check(st);
+    record = IndexKey(upsRecord.data, upsRecord.size);
+    return true;
+}
+
+IndexCursor::IndexCursor(Index &index, const IndexKey &pref, ups_txn_t *tr) : prefix(pref), first(pref) {
+    check(ups_cursor_create(&cursor, index.getDB(), tr, 0));
+}
+
+IndexCursor::IndexCursor(Index &index, const IndexKey &pref, const IndexKey &start, ups_txn_t *tr, bool rev) : prefix(pref), first(start), reverse(rev) {
+    check(ups_cursor_create(&cursor, index.getDB(), tr, 0));
+}
+
+IndexCursor::~IndexCursor() {
+    if(cursor != nullptr) {
+        // nothing to do with an error here
+        ups_cursor_close(cursor);
+    }
+}
+
+bool IndexCursor::next() {
+    if(over) {
+        return false;
+    }
+    ups_key_t key;
+    ups_record_t record;
+    memset(&key, 0, sizeof(key));
+    memset(&record, 0, sizeof(record));
+    ups_status_t st;
+    if(beforeFirst && reverse) {
+        beforeFirst = false;
+        IndexKey after;
+        if(first == prefix) {
+            after = prefix.successor();
+            if(after.size() == 0) {
+                st = ups_cursor_move(cursor, &key, &record, UPS_CURSOR_LAST);
+                return take(st, key, record);
+            }
+        }
+        const IndexKey &from = first == prefix ? after : first;
+        key.data = const_cast<void*>(from.data());
+        key.size = static_cast<uint16_t>(from.size());
+        st = ups_cursor_find(cursor, &key, &record, first == prefix ? UPS_FIND_LT_MATCH : UPS_FIND_LEQ_MATCH);
+    }
+    else if(reverse) {
+        st = ups_cursor_move(cursor, &key, &record, UPS_CURSOR_PREVIOUS);
+    }
+    else if(beforeFirst) {
+        beforeFirst = false;
+        if(first.size() == 0) {
+            st = ups_cursor_move(cursor, &key, &record, UPS_CURSOR_FIRST);
+        }
+        else {
+            key.data = const_cast<void*>(first.data());
+            key.size = static_cast<uint16_t>(first.size());
+            st = ups_cursor_find(cursor, &key, &record, UPS_FIND_GEQ_MATCH);
+        }
+    }
+    else {
+        st = ups_cursor_move(cursor, &key, &record, UPS_CURSOR_NEXT);
+    }
+    return take(st, key, record);
+}
+
+bool IndexCursor::take(ups_status_t st, ups_key_t &key, ups_record_t &record) {
+    if(st == UPS_KEY_NOT_FOUND) {
+        over = true;
+        return false;
+    }
+    check(st);
+    actualKey = IndexKey(key.data, key.size);
+    if(!actualKey.startsWith(prefix)) {
+        over = true;
+        return false;
+    }
+    actualRecord = IndexKey(record.data, record.size);
+    return true;
+}
+
+IndexKey EdgeEndIndex::makeKey(keyType start, keyType end, keyType edge) {
+    IndexKey key;
+    key << start << end << edge;
+    return key;
+}
+
+void EdgeEndIndex::add(keyType edge, RecordType rt, payloadType pt, keyType start, keyType end, ups_txn_t *tr) {
+    IndexKey record;
+    record << static_cast<uint8_t>(rt) << pt;
+    insert(makeKey(start, end, edge), record, tr);
+    if(rt == RT_UEDGE) {
+        insert(makeKey(end, start, edge), record, tr);
+    }
+}
+
+void EdgeEndIndex::addHead(keyType edge, uint8_t * const head, ups_txn_t *tr) {
+    RecordType rt = static_cast<RecordType>(head[FP_RECORDTYPE]);
+    if(rt == RT_DEDGE || rt == RT_UEDGE) {
+        add(edge, rt, static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)),
+            FixedFieldIO::getField(FPE_NODE_START, head), FixedFieldIO::getField(FPE_NODE_END, head), tr);
+    }
+}
+
+void EdgeEndIndex::remove(keyType edge, RecordType rt, keyType start, keyType end, ups_txn_t *tr) {
+    erase(makeKey(start, end, edge), tr);
+    if(rt == RT_UEDGE) {
+        erase(makeKey(end, start, edge), tr);
+    }
+}
+
+size_t EdgeEndIndex::collect(keyType from, keyType to, RecordType rt, deque<keyType> &result, ups_txn_t *tr, bool onlyFirst) {
+    IndexKey prefix;
+    prefix << from << to;
+    IndexCursor cursor(*this, prefix, tr);
+    size_t found = 0;
+    while(cursor.next()) {
+        if(rt == RT_INVALID || cursor.record().getUint8(0) == static_cast<uint8_t>(rt)) {
+            result.push_back(cursor.key().getUint64(2 * sizeof(keyType)));
+            found++;
+            if(onlyFirst) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+IndexKey AdjacencyIndex::makeKey(keyType node, FieldPosNode where, payloadType pt, keyType edge) {
+    IndexKey key;
+    key << node << static_cast<uint8_t>(where) << pt << edge;
+    return key;
+}
+
+void AdjacencyIndex::insert(keyType node, FieldPosNode where, payloadType pt, keyType edge, keyType other, ups_txn_t *tr) {
+    IndexKey record;
+    record << other;
+    Index::insert(makeKey(node, where, pt, edge), record, tr);
+}
+
+void AdjacencyIndex::add(keyType edge, RecordType rt, payloadType pt, keyType start, keyType end, ups_txn_t *tr) {
+    if(rt == RT_DEDGE) {
+        insert(start, FPN_OUT_BUCKETS, pt, edge, end, tr);
+        insert(end, FPN_IN_BUCKETS, pt, edge, start, tr);
+    }
+    else {
+        insert(start, FPN_UN_BUCKETS, pt, edge, end, tr);
+        insert(end, FPN_UN_BUCKETS, pt, edge, start, tr);
+    }
+}
+
+void AdjacencyIndex::addHead(keyType edge, uint8_t * const head, ups_txn_t *tr) {
+    RecordType rt = static_cast<RecordType>(head[FP_RECORDTYPE]);
+    if(rt == RT_DEDGE || rt == RT_UEDGE) {
+        add(edge, rt, static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)),
+            FixedFieldIO::getField(FPE_NODE_START, head), FixedFieldIO::getField(FPE_NODE_END, head), tr);
+    }
+}
+
+void AdjacencyIndex::remove(keyType edge, RecordType rt, payloadType pt, keyType start, keyType end, ups_txn_t *tr) {
+    if(rt == RT_DEDGE) {
+        erase(makeKey(start, FPN_OUT_BUCKETS, pt, edge), tr);
+        erase(makeKey(end, FPN_IN_BUCKETS, pt, edge), tr);
+    }
+    else {
+        erase(makeKey(start, FPN_UN_BUCKETS, pt, edge), tr);
+        erase(makeKey(end, FPN_UN_BUCKETS, pt, edge), tr);
+    }
+}
+
+size_t AdjacencyIndex::collect(keyType node, FieldPosNode where, payloadType pt, deque<keyType> &result, ups_txn_t *tr, deque<keyType> *others) {
+    IndexKey prefix;
+    prefix << node << static_cast<uint8_t>(where);
+    if(pt != PT_ANY) {
+        prefix << pt;
+    }
+    IndexCursor cursor(*this, prefix, tr);
+    size_t found = 0;
+    while(cursor.next()) {
+        result.push_back(cursor.key().getUint64(sizeof(keyType) + sizeof(uint8_t) + sizeof(payloadType)));
+        if(others != nullptr) {
+            others->push_back(cursor.record().getUint64(0));
+        }
+        found++;
+    }
+    return found;
+}
+
+bool AdjacencyIndex::exists(keyType node, FieldPosNode where, payloadType pt, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << node << static_cast<uint8_t>(where);
+    if(pt != PT_ANY) {
+        prefix << pt;
+    }
+    IndexCursor cursor(*this, prefix, tr);
+    return cursor.next();
+}
+
+bool AdjacencyIndex::forEach(keyType node, FieldPosNode where, payloadType pt, const function<bool(keyType)> &visit, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << node << static_cast<uint8_t>(where);
+    if(pt != PT_ANY) {
+        prefix << pt;
+    }
+    IndexCursor cursor(*this, prefix, tr);
+    while(cursor.next()) {
+        if(!visit(cursor.key().getUint64(sizeof(keyType) + sizeof(uint8_t) + sizeof(payloadType)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+IndexKey TypeIndex::makeKey(payloadType pt, keyType elem) {
+    IndexKey key;
+    key << pt << elem;
+    return key;
+}
+
+void TypeIndex::add(payloadType pt, keyType elem, ups_txn_t *tr) {
+    insert(makeKey(pt, elem), tr);
+}
+
+void TypeIndex::addHead(keyType elem, uint8_t * const head, ups_txn_t *tr) {
+    RecordType rt = static_cast<RecordType>(head[FP_RECORDTYPE]);
+    if(rt == RT_NODE || rt == RT_DEDGE || rt == RT_UEDGE) {
+        add(static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)), elem, tr);
+    }
+}
+
+void TypeIndex::remove(payloadType pt, keyType elem, ups_txn_t *tr) {
+    erase(makeKey(pt, elem), tr);
+}
+
+size_t TypeIndex::collect(payloadType pt, keyType from, size_t max, deque<keyType> &result, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << pt;
+    IndexCursor cursor(*this, prefix, makeKey(pt, from), tr);
+    size_t found = 0;
+    while(found < max && cursor.next()) {
+        result.push_back(cursor.key().getUint64(sizeof(payloadType)));
+        found++;
+    }
+    return found;
+}
+
+size_t TypeIndex::count(payloadType pt, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << pt;
+    IndexCursor cursor(*this, prefix, tr);
+    size_t found = 0;
+    while(cursor.next()) {
+        found++;
+    }
+    return found;
+}
+
+void TypeIndex::countAll(map<payloadType, size_t> &counts, ups_txn_t *tr) {
+    IndexCursor cursor(*this, IndexKey(), tr);
+    while(cursor.next()) {
+        counts[cursor.key().getUint32(0)]++;
+    }
+}
+
+IndexKey ExternalIdIndex::makeIdKey(const IndexKey &externalId) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IXI_ID);
+    key.append(externalId.data(), externalId.size());
+    return key;
+}
+
+IndexKey ExternalIdIndex::makeElemKey(keyType node) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IXI_ELEM) << node;
+    return key;
+}
+
+void ExternalIdIndex::add(const IndexKey &externalId, keyType node, ups_txn_t *tr) {
+    IndexKey record;
+    record << node;
+    insert(makeIdKey(externalId), record, tr);
+    insert(makeElemKey(node), externalId, tr);
+}
+
+bool ExternalIdIndex::lookup(const IndexKey &externalId, keyType &node, ups_txn_t *tr) {
+    IndexKey record;
+    if(!find(makeIdKey(externalId), record, tr)) {
+        return false;
+    }
+    node = record.getUint64(0);
+    return true;
+}
+
+void ExternalIdIndex::remove(keyType node, ups_txn_t *tr) {
+    IndexKey externalId;
+    if(find(makeElemKey(node), externalId, tr)) {
+        erase(makeIdKey(externalId), tr);
+        erase(makeElemKey(node), tr);
+    }
+}
+
+FieldRange FieldRange::all(bool desc) {
+    FieldRange range;
+    range.descending = desc;
+    return range;
+}
+
+FieldRange FieldRange::between(const IndexKey &f, const IndexKey &t, bool desc) {
+    FieldRange range;
+    range.from = f;
+    range.hasFrom = true;
+    range.to = t;
+    range.hasTo = true;
+    range.descending = desc;
+    return range;
+}
+
+FieldRange FieldRange::atLeast(const IndexKey &f, bool desc) {
+    FieldRange range;
+    range.from = f;
+    range.hasFrom = true;
+    range.descending = desc;
+    return range;
+}
+
+FieldRange FieldRange::atMost(const IndexKey &t, bool desc) {
+    FieldRange range;
+    range.to = t;
+    range.hasTo = true;
+    range.descending = desc;
+    return range;
+}
+
+FieldRange FieldRange::startingWith(const string &pref, bool desc) {
+    FieldRange range;
+    // without terminator, so longer strings match
+    range.prefix.append(pref.data(), pref.size());
+    range.descending = desc;
+    return range;
+}
+
+IndexKey FieldIndex::makeValueKey(const IndexKey &value, keyType elem) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IFV_VALUE);
+    key.append(value.data(), value.size());
+    key << elem;
+    return key;
+}
+
+IndexKey FieldIndex::makeElemKey(keyType elem) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IFV_ELEM) << elem;
+    return key;
+}
+
+IndexKey PayloadIndex::describe() const {
+    IndexKey descriptor;
+    descriptor << static_cast<uint8_t>(kind) << static_cast<uint32_t>(type) << static_cast<uint32_t>(id);
+    return descriptor;
+}
+
+bool IndexDescriptors::verify(const PayloadIndex &index, ups_txn_t *tr) {
+    IndexKey key;
+    key << static_cast<uint32_t>(index.getName());
+    IndexKey actual = index.describe();
+    IndexKey stored;
+    if(find(key, stored, tr)) {
+        return stored == actual;
+    }
+    insert(key, actual, tr);
+    return true;
+}
+
+void FieldIndex::update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) {
+    keyType elem = head.key;
+    IndexKey value;
+    bool has = extractor->extract(pl, value);
+    IndexKey old;
+    bool hadOld = find(makeElemKey(elem), old, tr);
+    if(hadOld && has && old == value) {
+        return;
+    }
+    if(hadOld) {
+        erase(makeValueKey(old, elem), tr);
+        erase(makeElemKey(elem), tr);
+    }
+    if(has) {
+        insert(makeValueKey(value, elem), tr);
+        insert(makeElemKey(elem), value, tr);
+    }
+}
+
+void FieldIndex::remove(keyType elem, ups_txn_t *tr) {
+    IndexKey old;
+    if(find(makeElemKey(elem), old, tr)) {
+        erase(makeValueKey(old, elem), tr);
+        erase(makeElemKey(elem), tr);
+    }
+}
+
+size_t FieldIndex::lookup(const IndexKey &value, deque<keyType> &result, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << static_cast<uint8_t>(IFV_VALUE);
+    prefix.append(value.data(), value.size());
+    IndexCursor cursor(*this, prefix, tr);
+    size_t found = 0;
+    while(cursor.next()) {
+        // a longer value may begin with this one
+        if(cursor.key().size() == prefix.size() + sizeof(keyType)) {
+            result.push_back(cursor.key().getUint64(prefix.size()));
+            found++;
+        }
+    }
+    return found;
+}
+
+size_t FieldIndex::lookupRange(const IndexKey &from, const IndexKey &to, deque<keyType> &result, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << static_cast<uint8_t>(IFV_VALUE);
+    IndexKey start(prefix);
+    start.append(from.data(), from.size());
+    IndexCursor cursor(*this, prefix, start, tr);
+    size_t found = 0;
+    while(cursor.next()) {
+        const IndexKey &key = cursor.key();
+        size_t valueSize = key.size() - prefix.size() - sizeof(keyType);
+        if(to < key.substr(prefix.size(), valueSize)) {
+            break;
+        }
+        result.push_back(key.getUint64(prefix.size() + valueSize));
+        found++;
+    }
+    return found;
+}
+
+size_t PayloadIndex::collectRange(const IndexKey &base, const FieldRange &range, IndexKey &resume, size_t max, deque<keyType> &result,
+        ups_txn_t *tr, const function<bool(const IndexKey&)> &accept) {
+    IndexKey prefix(base);
+    prefix.append(range.prefix.data(), range.prefix.size());
+    IndexKey start(prefix);
+    if(resume.size() > 0) {
+        start = resume;
+    }
+    else if(!range.descending && range.hasFrom && range.prefix < range.from) {
+        start = base;
+        start.append(range.from.data(), range.from.size());
+        start << static_cast<keyType>(0);
+    }
+    else if(range.descending && range.hasTo) {
+        IndexKey last(base);
+        last.append(range.to.data(), range.to.size());
+        last << numeric_limits<keyType>::max();
+        IndexKey after = prefix.successor();
+        if(after.size() == 0 || last < after) {
+            start = last;
+        }
+    }
+    IndexCursor cursor(*this, prefix, start, tr, range.descending);
+    IndexKey lastKey;
+    size_t found = 0;
+    while(found < max && cursor.next()) {
+        const IndexKey &key = cursor.key();
+        if(resume.size() > 0 && key == resume) {
+            continue;
+        }
+        size_t valueSize = key.size() - base.size() - sizeof(keyType);
+        IndexKey value = key.substr(base.size(), valueSize);
+        bool beyond = range.descending ? range.hasFrom && value < range.from : range.hasTo && range.to < value;
+        if(beyond) {
+            break;
+        }
+        // only possible next to the starting entry
+        if((range.hasFrom && value < range.from) || (range.hasTo && range.to < value)) {
+            continue;
+        }
+        // the next batch starts after the rejected entries too
+        lastKey = key;
+        if(accept && !accept(cursor.record())) {
+            continue;
+        }
+        result.push_back(key.getUint64(base.size() + valueSize));
+        found++;
+    }
+    if(lastKey.size() > 0) {
+        resume = lastKey;
+    }
+    return found;
+}
+
+size_t FieldIndex::collect(const FieldRange &range, IndexKey &resume, size_t max, deque<keyType> &result, ups_txn_t *tr) {
+    IndexKey base;
+    base << static_cast<uint8_t>(IFV_VALUE);
+    return collectRange(base, range, resume, max, result, tr);
+}
+
+constexpr double GeoIndex::earthRadius;
+
+static const double pi = 3.14159265358979323846;
+
+IndexKey GeoIndex::makeCellKey(uint64_t cell, keyType elem) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IGE_CELL) << cell << elem;
+    return key;
+}
+
+IndexKey GeoIndex::makeElemKey(keyType elem) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IGE_ELEM) << elem;
+    return key;
+}
+
+uint32_t GeoIndex::gridLat(double latitude) {
+    double pos = (latitude + 90.0) / 180.0 * 4294967296.0;
+    return pos <= 0.0 ? 0 : pos >= 4294967295.0 ? 0xffffffffu : static_cast<uint32_t>(pos);
+}
+
+uint32_t GeoIndex::gridLon(double longitude) {
+    double pos = (longitude + 180.0) / 360.0 * 4294967296.0;
+    return pos <= 0.0 ? 0 : pos >= 4294967295.0 ? 0xffffffffu : static_cast<uint32_t>(pos);
+}
+
+uint64_t GeoIndex::interleave(uint32_t x, uint32_t y) {
+    auto spread = [](uint64_t v) {
+        v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+        v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+        v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+double GeoIndex::distance(double lat1, double lon1, double lat2, double lon2) {
+    const double toRad = pi / 180.0;
+    double sinLat = sin((lat2 - lat1) * toRad / 2.0);
+    double sinLon = sin((lon2 - lon1) * toRad / 2.0);
+    double a = sinLat * sinLat + cos(lat1 * toRad) * cos(lat2 * toRad) * sinLon * sinLon;
+    return 2.0 * earthRadius * asin(min(1.0, sqrt(a)));
+}
+
+void GeoIndex::update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) {
+    keyType elem = head.key;
+    double latitude, longitude;
+    bool has = extractor->extract(pl, latitude, longitude);
+    remove(elem, tr);
+    if(has) {
+        uint64_t cell = interleave(gridLon(longitude), gridLat(latitude));
+        IndexKey position;
+        position << latitude << longitude;
+        insert(makeCellKey(cell, elem), position, tr);
+        IndexKey record;
+        record << cell << latitude << longitude;
+        insert(makeElemKey(elem), record, tr);
+    }
+}
+
+void GeoIndex::remove(keyType elem, ups_txn_t *tr) {
+    IndexKey old;
+    if(find(makeElemKey(elem), old, tr)) {
+        erase(makeCellKey(old.getUint64(0), elem), tr);
+        erase(makeElemKey(elem), tr);
+    }
+}
+
+size_t GeoIndex::collectBox(double minLat, double minLon, double maxLat, double maxLon, deque<keyType> &keys,
+        deque<pair<double, double>> *positions, ups_txn_t *tr) {
+    if(minLon <= maxLon) {
+        return collectSimpleBox(minLat, minLon, maxLat, maxLon, keys, positions, tr);
+    }
+    return collectSimpleBox(minLat, minLon, maxLat, 180.0, keys, positions, tr) +
+        collectSimpleBox(minLat, -180.0, maxLat, maxLon, keys, positions, tr);
+}
+
+size_t GeoIndex::collectSimpleBox(double minLat, double minLon, double maxLat, double maxLon, deque<keyType> &keys,
+        deque<pair<double, double>> *positions, ups_txn_t *tr) {
+    if(minLat > maxLat) {
+        return 0;
+    }
+    uint32_t x0 = gridLon(minLon), x1 = gridLon(maxLon), y0 = gridLat(minLat), y1 = gridLat(maxLat);
+    // the smallest aligned cells of which at most 3 x 3 cover the box
+    uint64_t extent = max(x1 - x0, y1 - y0) + static_cast<uint64_t>(1);
+    unsigned shift = 0;
+    while(shift < 32 && (static_cast<uint64_t>(1) << (shift + 1)) < extent) {
+        shift++;
+    }
+    uint64_t cellMask = shift == 32 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << (2 * shift)) - 1;
+    IndexKey prefix;
+    prefix << static_cast<uint8_t>(IGE_CELL);
+    size_t found = 0;
+    for(uint64_t cy = static_cast<uint64_t>(y0) >> shift; cy <= (static_cast<uint64_t>(y1) >> shift); cy++) {
+        for(uint64_t cx = static_cast<uint64_t>(x0) >> shift; cx <= (static_cast<uint64_t>(x1) >> shift); cx++) {
+            uint64_t first = interleave(static_cast<uint32_t>(cx << shift), static_cast<uint32_t>(cy << shift));
+            uint64_t last = first | cellMask;
+            IndexCursor cursor(*this, prefix, makeCellKey(first, 0), tr);
+            while(cursor.next() && cursor.key().getUint64(1) <= last) {
+                double latitude = cursor.record().getDouble(0);
+                double longitude = cursor.record().getDouble(sizeof(double));
+                if(latitude >= minLat && latitude <= maxLat && longitude >= minLon && longitude <= maxLon) {
+                    keys.push_back(cursor.key().getUint64(1 + sizeof(uint64_t)));
+                    if(positions != nullptr) {
+                        positions->push_back(make_pair(latitude, longitude));
+                    }
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void GeoIndex::nearest(double latitude, double longitude, size_t k, deque<keyType> &keys, deque<double> &distances, ups_txn_t *tr) {
+    if(k == 0) {
+        return;
+    }
+    const double toDeg = 180.0 / pi;
+    double radius = 1000.0;
+    vector<pair<double, keyType>> candidates;
+    while(true) {
+        bool wholeEarth = radius >= pi * earthRadius;
+        double angle = radius / earthRadius;
+        double minLat = latitude - angle * toDeg;
+        double maxLat = latitude + angle * toDeg;
+        double minLon = -180.0, maxLon = 180.0;
+        // the box must contain the whole spherical cap of the radius
+        if(!wholeEarth && minLat > -90.0 && maxLat < 90.0) {
+            double sinLon = sin(angle) / cos(latitude * pi / 180.0);
+            if(sinLon < 1.0) {
+                double delta = asin(sinLon) * toDeg;
+                minLon = longitude - delta;
+                maxLon = longitude + delta;
+                minLon = minLon < -180.0 ? minLon + 360.0 : minLon;
+                maxLon = maxLon > 180.0 ? maxLon - 360.0 : maxLon;
+            }
+        }
+        deque<keyType> found;
+        deque<pair<double, double>> positions;
+        collectBox(max(minLat, -90.0), minLon, min(maxLat, 90.0), maxLon, found, &positions, tr);
+        candidates.clear();
+        size_t inside = 0;
+        for(size_t i = 0; i < found.size(); i++) {
+            double dist = distance(latitude, longitude, positions[i].first, positions[i].second);
+            candidates.push_back(make_pair(dist, found[i]));
+            if(dist <= radius) {
+                inside++;
+            }
+        }
+        // the box may hold nearer elems outside the radius than the k-th inside
+        if(inside >= k || wholeEarth) {
+            break;
+        }
+        radius *= 4.0;
+    }
+    size_t count = min(k, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    for(size_t i = 0; i < count; i++) {
+        distances.push_back(candidates[i].first);
+        keys.push_back(candidates[i].second);
+    }
+}
+
+IndexKey VectorIndex::describe() const {
+    IndexKey descriptor = PayloadIndex::describe();
+    descriptor << static_cast<uint8_t>(params.metric) << static_cast<uint32_t>(params.maxLinks);
+    return descriptor;
+}
+
+IndexKey VectorIndex::makeVectorKey(keyType elem) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IVE_VECTOR) << elem;
+    return key;
+}
+
+IndexKey VectorIndex::makeLinksKey(keyType elem, uint8_t layer) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IVE_LINKS) << elem << layer;
+    return key;
+}
+
+IndexKey VectorIndex::makeLevelKey(uint8_t level, keyType elem) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IVE_LEVEL) << level << elem;
+    return key;
+}
+
+IndexKey VectorIndex::makeBacklinkKey(keyType elem, uint8_t layer, keyType source) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IVE_BACKLINK) << elem << layer << source;
+    return key;
+}
+
+float VectorIndex::distance(VectorMetric metric, const float * const a, const float * const b, size_t dim) {
+    // Independent partial sums let the compiler vectorize the inner loops
+    // for the target instruction set without reordering float additions.
+    const size_t lanes = 8;
+    size_t blocks = dim - dim % lanes;
+    if(metric == VectorMetric::EUCLIDEAN) {
+        float partial[lanes] = {};
+        for(size_t i = 0; i < blocks; i += lanes) {
+            for(size_t j = 0; j < lanes; j++) {
+                float diff = a[i + j] - b[i + j];
+                partial[j] += diff * diff;
+            }
+        }
+        float sum = 0.0f;
+        for(size_t j = 0; j < lanes; j++) {
+            sum += partial[j];
+        }
+        for(size_t i = blocks; i < dim; i++) {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sqrt(sum);
+    }
+    float partialDot[lanes] = {}, partialA[lanes] = {}, partialB[lanes] = {};
+    for(size_t i = 0; i < blocks; i += lanes) {
+        for(size_t j = 0; j < lanes; j++) {
+            partialDot[j] += a[i + j] * b[i + j];
+            partialA[j] += a[i + j] * a[i + j];
+            partialB[j] += b[i + j] * b[i + j];
+        }
+    }
+    float dot = 0.0f, normA = 0.0f, normB = 0.0f;
+    for(size_t j = 0; j < lanes; j++) {
+        dot += partialDot[j];
+        normA += partialA[j];
+        normB += partialB[j];
+    }
+    for(size_t i = blocks; i < dim; i++) {
+        dot += a[i] * b[i];
+        normA += a[i] * a[i];
+        normB += b[i] * b[i];
+    }
+    return normA == 0.0f || normB == 0.0f ? 1.0f : 1.0f - dot / sqrt(normA * normB);
+}
+
+uint8_t VectorIndex::levelOf(keyType elem) const {
+    // splitmix64 finalizer, so the level does not depend on the order of writes
+    uint64_t hash = elem + 0x9e3779b97f4a7c15ull;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    double uniform = (static_cast<double>(hash >> 11) + 1.0) / 9007199254740992.0;
+    double level = -log(uniform) / log(static_cast<double>(max<uint16_t>(params.maxLinks, 2)));
+    return static_cast<uint8_t>(min(level, 31.0));
+}
+
+bool VectorIndex::entryPoint(keyType &elem, uint8_t &level, ups_txn_t *tr) {
+    IndexKey prefix;
+    prefix << static_cast<uint8_t>(IVE_LEVEL);
+    IndexCursor cursor(*this, prefix, prefix, tr, true);
+    if(!cursor.next()) {
+        return false;
+    }
+    level = cursor.key().getUint8(1);
+    elem = cursor.key().getUint64(2);
+    return true;
+}
+
+const vector<float>* VectorIndex::getVector(keyType elem, VectorCache &cache, ups_txn_t *tr) {
+    auto found = cache.find(elem);
+    if(found != cache.end()) {
+        return &found->second;
+    }
+    IndexKey record;
+    if(!find(makeVectorKey(elem), record, tr)) {
+        return nullptr;
+    }
+    vector<float> &vec = cache[elem];
+    vec.resize((record.size() - 1) / sizeof(float));
+    memcpy(vec.data(), static_cast<const char*>(record.data()) + 1, vec.size() * sizeof(float));
+    return &vec;
+}
+
+void VectorIndex::readLinks(keyType elem, uint8_t layer, vector<keyType> &links, ups_txn_t *tr) {
+    links.clear();
+    IndexKey record;
+    if(find(makeLinksKey(elem, layer), record, tr)) {
+        for(size_t pos = 0; pos < record.size(); pos += sizeof(uint64_t)) {
+            links.push_back(record.getUint64(pos));
+        }
+    }
+}
+
+void VectorIndex::writeLinks(keyType elem, uint8_t layer, const vector<keyType> &links, ups_txn_t *tr) {
+    vector<keyType> old;
+    readLinks(elem, layer, old, tr);
+    for(keyType link : old) {
+        if(std::find(links.begin(), links.end(), link) == links.end()) {
+            erase(makeBacklinkKey(link, layer, elem), tr);
+        }
+    }
+    IndexKey record;
+    for(keyType link : links) {
+        record << link;
+        if(std::find(old.begin(), old.end(), link) == old.end()) {
+            insert(makeBacklinkKey(link, layer, elem), tr);
+        }
+    }
+    if(links.empty()) {
+        erase(makeLinksKey(elem, layer), tr);
+    }
+    else {
+        insert(makeLinksKey(elem, layer), record, tr);
+    }
+}
+
+void VectorIndex::readBacklinks(keyType elem, uint8_t layer, vector<keyType> &sources, ups_txn_t *tr) {
+    sources.clear();
+    IndexKey prefix;
+    prefix << static_cast<uint8_t>(IVE_BACKLINK) << elem << layer;
+    IndexCursor cursor(*this, prefix, tr);
+    while(cursor.next()) {
+        sources.push_back(cursor.key().getUint64(prefix.size()));
+    }
+}
+
+void VectorIndex::searchLayer(const vector<float> &query, vector<Scored> &found, size_t ef, uint8_t layer, VectorCache &cache, ups_txn_t *tr) {
+    priority_queue<Scored, vector<Scored>, greater<Scored>> candidates;
+    priority_queue<Scored> nearest;
+    unordered_set<keyType> visited;
+    for(Scored &entry : found) {
+        visited.insert(entry.second);
+        candidates.push(entry);
+        nearest.push(entry);
+    }
+    while(nearest.size() > ef) {
+        nearest.pop();
+    }
+    vector<keyType> links;
+    while(!candidates.empty()) {
+        Scored actual = candidates.top();
+        if(nearest.size() >= ef && actual.first > nearest.top().first) {
+            break;
+        }
+        candidates.pop();
+        readLinks(actual.second, layer, links, tr);
+        for(keyType link : links) {
+            if(!visited.insert(link).second) {
+                continue;
+            }
+            const vector<float> *vec = getVector(link, cache, tr);
+            // not expected, remove repairs all lists linking to the elem
+            if(vec == nullptr) {
+                continue;
+            }
+            float dist = distance(params.metric, query.data(), vec->data(), query.size());
+            if(nearest.size() < ef || dist < nearest.top().first) {
+                candidates.push(make_pair(dist, link));
+                nearest.push(make_pair(dist, link));
+                if(nearest.size() > ef) {
+                    nearest.pop();
+                }
+            }
+        }
+    }
+    found.resize(nearest.size());
+    for(size_t i = found.size(); i > 0; i--) {
+        found[i - 1] = nearest.top();
+        nearest.pop();
+    }
+}
+
+void VectorIndex::selectNeighbours(const vector<Scored> &candidates, size_t max, vector<keyType> &selected, VectorCache &cache, ups_txn_t *tr) {
+    selected.clear();
+    vector<const vector<float>*> selectedVectors;
+    vector<keyType> skipped;
+    for(const Scored &candidate : candidates) {
+        if(selected.size() >= max) {
+            break;
+        }
+        const vector<float> *vec = getVector(candidate.second, cache, tr);
+        if(vec == nullptr) {
+            continue;
+        }
+        bool diverse = true;
+        for(const vector<float> *other : selectedVectors) {
+            if(distance(params.metric, vec->data(), other->data(), vec->size()) < candidate.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if(diverse) {
+            selected.push_back(candidate.second);
+            selectedVectors.push_back(vec);
+        }
+        else {
+            skipped.push_back(candidate.second);
+        }
+    }
+    for(size_t i = 0; i < skipped.size() && selected.size() < max; i++) {
+        selected.push_back(skipped[i]);
+    }
+}
+
+void VectorIndex::addLink(keyType elem, keyType link, uint8_t layer, VectorCache &cache, ups_txn_t *tr) {
+    vector<keyType> links;
+    readLinks(elem, layer, links, tr);
+    if(std::find(links.begin(), links.end(), link) != links.end()) {
+        return;
+    }
+    links.push_back(link);
+    const vector<float> *base = getVector(elem, cache, tr);
+    if(links.size() > maxLinksOn(layer) && base != nullptr) {
+        vector<Scored> candidates;
+        for(keyType other : links) {
+            const vector<float> *vec = getVector(other, cache, tr);
+            if(vec != nullptr) {
+                candidates.push_back(make_pair(distance(params.metric, base->data(), vec->data(), base->size()), other));
+            }
+        }
+        sort(candidates.begin(), candidates.end());
+        selectNeighbours(candidates, maxLinksOn(layer), links, cache, tr);
+    }
+    writeLinks(elem, layer, links, tr);
+}
+
+void VectorIndex::insertVector(keyType elem, const vector<float> &vec, ups_txn_t *tr) {
+    VectorCache cache;
+    keyType entry;
+    uint8_t top;
+    bool hasEntry = entryPoint(entry, top, tr);
+    const vector<float> *entryVector = hasEntry ? getVector(entry, cache, tr) : nullptr;
+    if(entryVector != nullptr && entryVector->size() != vec.size()) {
+        throw IllegalArgumentException((string("Vector dimension ") + to_string(vec.size()) +
+            " differs from the indexed " + to_string(entryVector->size()) + ".").c_str());
+    }
+    uint8_t level = levelOf(elem);
+    IndexKey record;
+    record << level;
+    record.append(vec.data(), vec.size() * sizeof(float));
+    insert(makeVectorKey(elem), record, tr);
+    insert(makeLevelKey(level, elem), tr);
+    if(entryVector == nullptr) {
+        return;
+    }
+    cache[elem] = vec;
+    vector<Scored> found;
+    found.push_back(make_pair(distance(params.metric, vec.data(), entryVector->data(), vec.size()), entry));
+    for(unsigned layer = top; layer > level; layer--) {
+        searchLayer(vec, found, 1, static_cast<uint8_t>(layer), cache, tr);
+    }
+    vector<keyType> neighbours;
+    for(int layer = min(top, level); layer >= 0; layer--) {
+        searchLayer(vec, found, params.efConstruction, static_cast<uint8_t>(layer), cache, tr);
+        selectNeighbours(found, params.maxLinks, neighbours, cache, tr);
+        writeLinks(elem, static_cast<uint8_t>(layer), neighbours, tr);
+        for(keyType neighbour : neighbours) {
+            addLink(neighbour, elem, static_cast<uint8_t>(layer), cache, tr);
+        }
+    }
+}
+
+void VectorIndex::update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) {
+    keyType elem = head.key;
+    vector<float> vec;
+    bool has = params.extractor->extract(pl, vec) && vec.size() > 0;
+    IndexKey old;
+    if(has && find(makeVectorKey(elem), old, tr) && old.size() == 1 + vec.size() * sizeof(float) &&
+            memcmp(static_cast<const char*>(old.data()) + 1, vec.data(), vec.size() * sizeof(float)) == 0) {
+        // unchanged vector, keep the links
+        return;
+    }
+    remove(elem, tr);
+    if(has) {
+        insertVector(elem, vec, tr);
+    }
+}
+
+void VectorIndex::remove(keyType elem, ups_txn_t *tr) {
+    IndexKey record;
+    if(!find(makeVectorKey(elem), record, tr)) {
+        return;
+    }
+    uint8_t level = record.getUint8(0);
+    erase(makeVectorKey(elem), tr);
+    erase(makeLevelKey(level, elem), tr);
+    VectorCache cache;
+    vector<keyType> links, affected, neighbourLinks;
+    for(unsigned layer = 0; layer <= level; layer++) {
+        readLinks(elem, static_cast<uint8_t>(layer), links, tr);
+        readBacklinks(elem, static_cast<uint8_t>(layer), affected, tr);
+        writeLinks(elem, static_cast<uint8_t>(layer), vector<keyType>(), tr);
+        affected.insert(affected.end(), links.begin(), links.end());
+        sort(affected.begin(), affected.end());
+        affected.erase(unique(affected.begin(), affected.end()), affected.end());
+        for(keyType neighbour : affected) {
+            const vector<float> *base = getVector(neighbour, cache, tr);
+            if(base == nullptr) {
+                continue;
+            }
+            // the neighbour may inherit the neighbours of the removed elem, which
+            // is dropped from the list as its vector is not found any more
+            readLinks(neighbour, static_cast<uint8_t>(layer), neighbourLinks, tr);
+            neighbourLinks.insert(neighbourLinks.end(), links.begin(), links.end());
+            vector<Scored> candidates;
+            for(keyType other : neighbourLinks) {
+                const vector<float> *vec = other == neighbour ? nullptr : getVector(other, cache, tr);
+                if(vec != nullptr) {
+                    candidates.push_back(make_pair(distance(params.metric, base->data(), vec->data(), base->size()), other));
+                }
+            }
+            sort(candidates.begin(), candidates.end());
+            candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+            selectNeighbours(candidates, maxLinksOn(static_cast<uint8_t>(layer)), neighbourLinks, cache, tr);
+            writeLinks(neighbour, static_cast<uint8_t>(layer), neighbourLinks, tr);
+        }
+    }
+}
+
+void VectorIndex::nearest(const vector<float> &query, size_t k, size_t ef, deque<keyType> &keys, deque<double> &distances, ups_txn_t *tr) {
+    keyType entry;
+    uint8_t top;
+    if(k == 0 || !entryPoint(entry, top, tr)) {
+        return;
+    }
+    VectorCache cache;
+    const vector<float> *entryVector = getVector(entry, cache, tr);
+    if(entryVector == nullptr || entryVector->size() != query.size()) {
+        throw IllegalArgumentException((string("Query vector dimension ") + to_string(query.size()) + " differs from the indexed one.").c_str());
+    }
+    vector<Scored> found;
+    found.push_back(make_pair(distance(params.metric, query.data(), entryVector->data(), query.size()), entry));
+    for(unsigned layer = top; layer > 0; layer--) {
+        searchLayer(query, found, 1, static_cast<uint8_t>(layer), cache, tr);
+    }
+    searchLayer(query, found, max(k, ef == 0 ? static_cast<size_t>(params.efSearch) : ef), 0, cache, tr);
+    for(size_t i = 0; i < found.size() && i < k; i++) {
+        keys.push_back(found[i].second);
+        distances.push_back(found[i].first);
+    }
+}
+
+IndexKey EdgeOrderIndex::makeListKey(keyType node, const IndexKey &value, keyType edge) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IEO_LIST) << node;
+    key.append(value.data(), value.size());
+    key << edge;
+    return key;
+}
+
+IndexKey EdgeOrderIndex::makeEdgeKey(keyType edge) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IEO_EDGE) << edge;
+    return key;
+}
+
+void EdgeOrderIndex::insertEntry(keyType node, const IndexKey &value, keyType edge, uint8_t ends, keyType other, ups_txn_t *tr) {
+    IndexKey record;
+    record << ends << other;
+    insert(makeListKey(node, value, edge), record, tr);
+}
+
+void EdgeOrderIndex::update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) {
+    if(head.recordType != RT_DEDGE && head.recordType != RT_UEDGE) {
+        return;
+    }
+    IndexKey value;
+    bool has = extractor->extract(pl, value);
+    IndexKey record;
+    record << head.start << head.end << static_cast<uint8_t>(head.recordType);
+    record.append(value.data(), value.size());
+    IndexKey old;
+    bool hadOld = find(makeEdgeKey(head.key), old, tr);
+    if(hadOld && has && old == record) {
+        return;
+    }
+    if(hadOld) {
+        remove(head.key, tr);
+    }
+    if(has) {
+        uint8_t startEnd = head.recordType == RT_DEDGE ? EEB_OUT : EEB_UN;
+        uint8_t endEnd = head.recordType == RT_DEDGE ? EEB_IN : EEB_UN;
+        if(head.start == head.end) {
+            insertEntry(head.start, value, head.key, startEnd | endEnd, head.end, tr);
+        }
+        else {
+            insertEntry(head.start, value, head.key, startEnd, head.end, tr);
+            insertEntry(head.end, value, head.key, endEnd, head.start, tr);
+        }
+        insert(makeEdgeKey(head.key), record, tr);
+    }
+}
+
+void EdgeOrderIndex::remove(keyType elem, ups_txn_t *tr) {
+    IndexKey old;
+    if(!find(makeEdgeKey(elem), old, tr)) {
+        return;
+    }
+    keyType start = old.getUint64(0);
+    keyType end = old.getUint64(sizeof(keyType));
+    size_t valuePos = 2 * sizeof(keyType) + sizeof(uint8_t);
+    IndexKey value = old.substr(valuePos, old.size() - valuePos);
+    erase(makeListKey(start, value, elem), tr);
+    if(end != start) {
+        erase(makeListKey(end, value, elem), tr);
+    }
+    erase(makeEdgeKey(elem), tr);
+}
+
+size_t EdgeOrderIndex::collect(keyType node, uint8_t ends, const FieldRange &range, IndexKey &resume, size_t max, deque<keyType> &result, ups_txn_t *tr) {
+    IndexKey base;
+    base << static_cast<uint8_t>(IEO_LIST) << node;
+    return collectRange(base, range, resume, max, result, tr, [ends](const IndexKey &record) {
+        return (record.getUint8(0) & ends) != 0;
+    });
+}
+
+IndexKey AggregateIndex::makeNodeKey(keyType node, uint8_t end) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IAG_NODE) << node << end;
+    return key;
+}
+
+IndexKey AggregateIndex::makeEdgeKey(keyType edge) {
+    IndexKey key;
+    key << static_cast<uint8_t>(IAG_EDGE) << edge;
+    return key;
+}
+
+void AggregateIndex::add(keyType node, uint8_t end, int64_t count, double value, ups_txn_t *tr) {
+    IndexKey key = makeNodeKey(node, end);
+    IndexKey record;
+    uint64_t oldCount = 0;
+    double oldSum = 0.0;
+    if(find(key, record, tr)) {
+        oldCount = record.getUint64(0);
+        oldSum = record.getDouble(sizeof(uint64_t));
+    }
+    uint64_t newCount = oldCount + count;
+    if(newCount == 0) {
+        erase(key, tr);
+    }
+    else {
+        IndexKey newRecord;
+        newRecord << newCount << oldSum + value;
+        insert(key, newRecord, tr);
+    }
+}
+
+void AggregateIndex::update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) {
+    if(head.recordType != RT_DEDGE && head.recordType != RT_UEDGE) {
+        return;
+    }
+    double value = 0.0;
+    bool has = extractor == nullptr || extractor->extract(pl, value);
+    IndexKey record;
+    record << head.start << head.end << static_cast<uint8_t>(head.recordType) << value;
+    IndexKey old;
+    bool hadOld = find(makeEdgeKey(head.key), old, tr);
+    if(hadOld && has && old == record) {
+        return;
+    }
+    if(hadOld) {
+        remove(head.key, tr);
+    }
+    if(has) {
+        addEdge(head.start, head.end, head.recordType, 1, value, tr);
+        insert(makeEdgeKey(head.key), record, tr);
+    }
+}
+
+void AggregateIndex::remove(keyType elem, ups_txn_t *tr) {
+    IndexKey old;
+    if(find(makeEdgeKey(elem), old, tr)) {
+        keyType start = old.getUint64(0);
+        keyType end = old.getUint64(sizeof(keyType));
+        RecordType rt = static_cast<RecordType>(old.getUint8(2 * sizeof(keyType)));
+        double value = old.getDouble(2 * sizeof(keyType) + sizeof(uint8_t));
+        addEdge(start, end, rt, -1, -value, tr);
+        erase(makeEdgeKey(elem), tr);
+    }
+    else {
+        // not a counted edge, may be a node
+        erase(makeNodeKey(elem, EEB_IN), tr);
+        erase(makeNodeKey(elem, EEB_OUT), tr);
+        erase(makeNodeKey(elem, EEB_UN), tr);
+    }
+}
+
+void AggregateIndex::addEdge(keyType start, keyType end, RecordType rt, int64_t count, double value, ups_txn_t *tr) {
+    if(start == end) {
+        // a loop is counted at both of its ends like in the degrees of the node
+        if(rt == RT_DEDGE) {
+            add(start, EEB_OUT, count, value, tr);
+            add(start, EEB_IN, count, value, tr);
+        }
+        else {
+            add(start, EEB_UN, 2 * count, 2 * value, tr);
+        }
+    }
+    else {
+        add(start, rt == RT_DEDGE ? EEB_OUT : EEB_UN, count, value, tr);
+        add(end, rt == RT_DEDGE ? EEB_IN : EEB_UN, count, value, tr);
+    }
+}
+
+EdgeAggregate AggregateIndex::get(keyType node, uint8_t ends, ups_txn_t *tr) {
+    EdgeAggregate result;
+    IndexKey record;
+    for(uint8_t end : {EEB_IN, EEB_OUT, EEB_UN}) {
+        if((ends & end) != 0 && find(makeNodeKey(node, end), record, tr)) {
+            result.count += record.getUint64(0);
+            result.sum += record.getDouble(sizeof(uint64_t));
+        }
+    }
+    return result;
+}
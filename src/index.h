@@ -0,0 +1,907 @@
+/** @file
+Index databases stored beside the graph database in the same UpscaleDB environment.
+
+COPYRIGHT COMES HERE
+*/
+
+#ifndef UDB_INDEX_H
+#define UDB_INDEX_H
+
+#include<string>
+#include<deque>
+#include<map>
+#include<functional>
+#include<vector>
+#include<memory>
+#include<unordered_map>
+#include<ups/upscaledb.h>
+
+#if USE_NVWA == 1
+#include"debug_new.h"
+#endif
+
+#include"udbgraph_config.h"
+#include"serializer.h"
+
+namespace udbgraph {
+
+    /** UpscaleDB database names inside the environment. DBN_GRAPH holds the
+    record chains, DBN_INDEX_DESCRIPTORS the descriptors of the payload indexes,
+    the others are indexes maintained by the library. */
+    enum DatabaseName : uint16_t {
+        DBN_INVALID, DBN_GRAPH, DBN_EDGE_ENDS, DBN_ADJACENCY, DBN_INDEX_DESCRIPTORS, DBN_TYPES, DBN_EXTERNAL_IDS, DBN_NOMORE,
+        /** Payload field indexes get the names from here on in the order of registration. */
+        DBN_FIELD_FIRST = 256,
+
+        /** Spatial indexes get the names from here on in the order of registration. */
+        DBN_GEO_FIRST = 512,
+
+        /** Vector indexes get the names from here on in the order of registration. */
+        DBN_VECTOR_FIRST = 768,
+
+        /** Ordered edge lists get the names from here on in the order of registration. */
+        DBN_EDGE_ORDER_FIRST = 1024,
+
+        /** Edge aggregates get the names from here on in the order of registration. */
+        DBN_AGGREGATE_FIRST = 1280
+    };
+
+    /** Bits telling which end of an edge a node is in the indexes of edges by node,
+    a loop has both. */
+    enum EdgeEndBits : uint8_t {
+        EEB_IN = 1, EEB_OUT = 2, EEB_UN = 4, EEB_ANY = 7
+    };
+
+    class Payload;
+    class HeadFields;
+
+    /** Composite key or record for index databases. Integer components are
+    stored big-endian regardless of the architecture, so the byte-wise comparison
+    UpscaleDB performs on binary keys yields the numeric order of the components
+    from left to right. This way a key prefix selects a contiguous key range. */
+    class IndexKey final {
+    protected:
+        /** The assembled bytes. */
+        std::string content;
+
+    public:
+        /** Creates an empty key. */
+        IndexKey() {}
+
+        /** Creates a key from raw bytes, for example from a cursor. */
+        IndexKey(const void * const data, size_t size) : content(static_cast<const char*>(data), size) {}
+
+        /** Appends a byte. */
+        IndexKey& operator<<(uint8_t value);
+
+        /** Appends a 32-bit unsigned integer big-endian. */
+        IndexKey& operator<<(uint32_t value);
+
+        /** Appends a 64-bit unsigned integer big-endian. */
+        IndexKey& operator<<(uint64_t value);
+
+        /** Appends a 32-bit signed integer big-endian with the sign bit flipped,
+         * so negative values precede positive ones. */
+        IndexKey& operator<<(int32_t value);
+
+        /** Appends a 64-bit signed integer like the 32-bit one. */
+        IndexKey& operator<<(int64_t value);
+
+        /** Appends a double so that the byte-wise order follows the numeric order.
+         * NaN values are not supported. */
+        IndexKey& operator<<(double value);
+
+        /** Appends the characters followed by a zero byte, so a shorter string
+         * precedes its extensions even if more components follow. The string
+        must not contain zero bytes. */
+        IndexKey& operator<<(const std::string &value);
+
+        /** Appends raw bytes without terminator, for prefixes. */
+        IndexKey& append(const void * const data, size_t size);
+
+        /** Returns the byte at pos. */
+        uint8_t getUint8(size_t pos) const;
+
+        /** Returns the 32-bit unsigned integer starting at pos. */
+        uint32_t getUint32(size_t pos) const;
+
+        /** Returns the 64-bit unsigned integer starting at pos. */
+        uint64_t getUint64(size_t pos) const;
+
+        /** Reads a double appended with operator<<. */
+        double getDouble(size_t pos) const;
+
+        /** Returns true if this key begins with prefix. */
+        bool startsWith(const IndexKey &prefix) const noexcept {
+            return content.compare(0, prefix.content.size(), prefix.content) == 0;
+        }
+
+        /** Returns the length in bytes. */
+        size_t size() const noexcept { return content.size(); }
+
+        /** Returns the raw content. */
+        const void* data() const noexcept { return content.data(); }
+
+        /** Returns the smallest key greater than all keys beginning with this one,
+         * or an empty key if there is no such key. */
+        IndexKey successor() const;
+
+        /** Returns the part of the key from pos on with length len. */
+        IndexKey substr(size_t pos, size_t len) const { return IndexKey(content.data() + pos, len); }
+
+        /** Empties the key. */
+        void clear() noexcept { content.clear(); }
+
+        /** Byte-wise equality. */
+        bool operator==(const IndexKey &other) const noexcept { return content == other.content; }
+
+        /** Byte-wise order, the same UpscaleDB uses. */
+        bool operator<(const IndexKey &other) const noexcept { return content < other.content; }
+    };
+
+    /** An UpscaleDB database with variable length binary IndexKey keys and short
+    records. The instance does not own the environment, and closing the environment
+    closes the database as well. */
+    class Index : public CheckUpsCall {
+    protected:
+        /** UpscaleDB database, nullptr if not open. */
+        ups_db_t *db = nullptr;
+
+        /** Name of the database inside the environment. */
+        DatabaseName name;
+
+    public:
+        /** Sets the name only, create or open must be called before use. */
+        Index(DatabaseName n) noexcept : name(n) {}
+
+        virtual ~Index() {}
+
+        /** Creates the database in the environment. */
+        void create(ups_env_t *env);
+
+        /** Opens the database in the environment.
+        @return false if it does not exist yet. */
+        bool open(ups_env_t *env);
+
+        /** Forgets the database handle, for use when closing the environment. */
+        void close() noexcept { db = nullptr; }
+
+        /** Returns the UpscaleDB database. */
+        ups_db_t* getDB() const noexcept { return db; }
+
+        /** Returns the name of the database inside the environment. */
+        DatabaseName getName() const noexcept { return name; }
+
+        /** Inserts or overwrites the entry. */
+        void insert(const IndexKey &key, const IndexKey &record, ups_txn_t *tr);
+
+        /** Inserts or overwrites the entry with empty record. */
+        void insert(const IndexKey &key, ups_txn_t *tr);
+
+        /** Erases the entry. @return false if it was not found. */
+        bool erase(const IndexKey &key, ups_txn_t *tr);
+
+        /** Looks up the exact key and copies its record into record if found.
+        @return true if found. */
+        bool find(const IndexKey &key, IndexKey &record, ups_txn_t *tr);
+
+        /** Registers the elem using its raw head record when the index is built
+         * from an existing database. This implementation does nothing. */
+        virtual void addHead(keyType, uint8_t * const, ups_txn_t*) {}
+    };
+
+    /** Extracts the value of a payload field to be indexed. Instances are registered
+     * with GEFactory::regIndex for a payload type. The implementations will have to
+    cast pl to the intended payload type, and must be thread-safe. */
+    class FieldExtractor {
+    public:
+        virtual ~FieldExtractor() {}
+
+        /** Appends the indexed value of pl into value using the IndexKey operators.
+        @return false if pl has no value to index. */
+        virtual bool extract(const Payload * const pl, IndexKey &value) const = 0;
+    };
+
+    /** Extracts the position of a geo-tagged payload for a spatial index. Instances
+     * are registered with GEFactory::regGeoIndex for a payload type. The
+    implementations will have to cast pl to the intended payload type, and must
+    be thread-safe. */
+    class GeoExtractor {
+    public:
+        virtual ~GeoExtractor() {}
+
+        /** Sets the position of pl in degrees.
+        @return false if pl has no position. */
+        virtual bool extract(const Payload * const pl, double &latitude, double &longitude) const = 0;
+    };
+
+    /** Extracts the vector of a payload holding an embedding for a vector index.
+     * Instances are registered with GEFactory::regVectorIndex for a payload type.
+    The implementations will have to cast pl to the intended payload type, and must
+    be thread-safe. */
+    class VectorExtractor {
+    public:
+        virtual ~VectorExtractor() {}
+
+        /** Copies the vector of pl into vec. All vectors of an index must have the same dimension.
+        @return false if pl has no vector. */
+        virtual bool extract(const Payload * const pl, std::vector<float> &vec) const = 0;
+    };
+
+    /** Distance functions for vector indexes. */
+    enum class VectorMetric : uint8_t {
+        /** Euclidean distance. */
+        EUCLIDEAN,
+        /** 1 - cosine similarity. */
+        COSINE
+    };
+
+    /** Extracts a number from an edge payload for the aggregates of an AggregateIndex.
+     * Instances are registered with GEFactory::regAggregate for a payload type. The
+    implementations will have to cast pl to the intended payload type, and must be
+    thread-safe. */
+    class ValueExtractor {
+    public:
+        virtual ~ValueExtractor() {}
+
+        /** Sets the value of pl to add to the sums.
+        @return false if pl has no value, then the edge is left out of the aggregates. */
+        virtual bool extract(const Payload * const pl, double &value) const = 0;
+    };
+
+    /** Count and sum of the values of edges at a node, see AggregateIndex. */
+    class EdgeAggregate final {
+    public:
+        /** Number of the edges having a value. */
+        uint64_t count = 0;
+
+        /** Sum of the values. */
+        double sum = 0.0;
+
+        /** Returns the mean of the values, 0 if there is none. */
+        double average() const noexcept { return count == 0 ? 0.0 : sum / count; }
+    };
+
+    /** Cursor iterating over the index entries sharing a common key prefix
+    in ascending key order. The entries are read one by one as next is called. */
+    class IndexCursor final : public CheckUpsCall {
+    protected:
+        /** UpscaleDB cursor. */
+        ups_cursor_t *cursor = nullptr;
+
+        /** Only keys beginning with this are returned. */
+        IndexKey prefix;
+
+        /** Key of the actual entry. */
+        IndexKey actualKey;
+
+        /** Record of the actual entry. */
+        IndexKey actualRecord;
+
+        /** True before the first call to next. */
+        bool beforeFirst = true;
+
+        /** True after the iteration has left the prefix range. */
+        bool over = false;
+
+        /** The first key searched for. */
+        IndexKey first;
+
+        /** True if the cursor steps backwards. */
+        bool reverse = false;
+
+    public:
+        /** Creates the cursor in the given transaction. */
+        IndexCursor(Index &index, const IndexKey &pref, ups_txn_t *tr);
+
+        /** Creates the cursor starting at the first key not less than start,
+         * which must begin with pref. If rev is set, the cursor steps backwards
+        starting at the last key not greater than start, or at the last key of the
+        prefix range if start equals pref. */
+        IndexCursor(Index &index, const IndexKey &pref, const IndexKey &start, ups_txn_t *tr, bool rev = false);
+
+        /** Closes the UpscaleDB cursor. */
+        ~IndexCursor();
+
+        IndexCursor(const IndexCursor &other) = delete;
+
+        IndexCursor& operator=(const IndexCursor &other) = delete;
+
+        /** Steps to the first or next entry in the prefix range.
+        @return false if there are no more entries. */
+        bool next();
+
+        /** Returns the key of the actual entry. */
+        const IndexKey& key() const noexcept { return actualKey; }
+
+        /** Returns the record of the actual entry. */
+        const IndexKey& record() const noexcept { return actualRecord; }
+
+    protected:
+        /** Copies the entry, checks the prefix and sets over accordingly. */
+        bool take(ups_status_t st, ups_key_t &key, ups_record_t &record);
+    };
+
+    /** Index of edges between two nodes. Each entry has the key
+    (start node, end node, edge) and the record (RecordType, payloadType).
+    Undirected edges are stored in both orientations, so looking up one node pair
+    in one order finds the directed edges in that direction and all undirected ones. */
+    class EdgeEndIndex final : public Index {
+    public:
+        /** Sets the database name. */
+        EdgeEndIndex() noexcept : Index(DBN_EDGE_ENDS) {}
+
+        /** Registers the edge. */
+        void add(keyType edge, RecordType rt, payloadType pt, keyType start, keyType end, ups_txn_t *tr);
+
+        /** Registers the edge using its raw head record. Other record types are ignored. */
+        virtual void addHead(keyType edge, uint8_t * const head, ups_txn_t *tr) override;
+
+        /** Removes the edge. */
+        void remove(keyType edge, RecordType rt, keyType start, keyType end, ups_txn_t *tr);
+
+        /** Appends the keys of edges leading from 'from' to 'to' into result.
+        @param rt RT_DEDGE or RT_UEDGE to restrict the edge type, RT_INVALID for both.
+        @param onlyFirst stop at the first found edge.
+        @return the number of keys appended. */
+        size_t collect(keyType from, keyType to, RecordType rt, std::deque<keyType> &result, ups_txn_t *tr, bool onlyFirst = false);
+
+    protected:
+        /** Assembles the key. */
+        static IndexKey makeKey(keyType start, keyType end, keyType edge);
+    };
+
+    /** Adjacency lists of the nodes partitioned by edge payload type. Each entry
+    has the key (node, end type, payloadType, edge), where end type tells if the edge
+    is incoming, outgoing or undirected at the node, using the FPN_*_BUCKETS value
+    of the corresponding hash table. The record holds the key of the node at the
+    other end. This way the edges of a node having the given type and the
+    neighbouring nodes can be enumerated without reading any edge record. */
+    class AdjacencyIndex final : public Index {
+    public:
+        /** Sets the database name. */
+        AdjacencyIndex() noexcept : Index(DBN_ADJACENCY) {}
+
+        /** Registers the edge at both of its nodes. */
+        void add(keyType edge, RecordType rt, payloadType pt, keyType start, keyType end, ups_txn_t *tr);
+
+        /** Registers the edge using its raw head record. Other record types are ignored. */
+        virtual void addHead(keyType edge, uint8_t * const head, ups_txn_t *tr) override;
+
+        /** Removes the edge from both of its nodes. */
+        void remove(keyType edge, RecordType rt, payloadType pt, keyType start, keyType end, ups_txn_t *tr);
+
+        /** Appends the keys of edges of the given type and end type at node into result.
+        @param where FPN_IN_BUCKETS, FPN_OUT_BUCKETS or FPN_UN_BUCKETS.
+        @param pt the payload type or PT_ANY for all edges.
+        @param others if not nullptr, the keys of the nodes at the other end are
+        appended into it in the same order.
+        @return the number of keys appended. */
+        size_t collect(keyType node, FieldPosNode where, payloadType pt, std::deque<keyType> &result, ups_txn_t *tr, std::deque<keyType> *others = nullptr);
+
+        /** Returns true if the node has at least one edge of the end type and
+         * payload type, reading a single index entry. */
+        bool exists(keyType node, FieldPosNode where, payloadType pt, ups_txn_t *tr);
+
+        /** Calls visit with the keys of the edges of the given type and end type at
+         * node one by one, reading the entries only as long as visit returns true.
+        @return false if visit stopped the iteration. */
+        bool forEach(keyType node, FieldPosNode where, payloadType pt, const std::function<bool(keyType)> &visit, ups_txn_t *tr);
+
+    protected:
+        /** Assembles the key. */
+        static IndexKey makeKey(keyType node, FieldPosNode where, payloadType pt, keyType edge);
+
+        /** Inserts the entry with the other node as record. */
+        void insert(keyType node, FieldPosNode where, payloadType pt, keyType edge, keyType other, ups_txn_t *tr);
+    };
+
+    /** Extent index of the nodes and edges by payload type. Each entry has the
+    key (payloadType, elem) with empty record, so the elems of a type can be
+    enumerated in key order without reading the graph database. */
+    class TypeIndex final : public Index {
+    public:
+        /** Sets the database name. */
+        TypeIndex() noexcept : Index(DBN_TYPES) {}
+
+        /** Registers the elem. */
+        void add(payloadType pt, keyType elem, ups_txn_t *tr);
+
+        /** Registers the node or edge using its raw head record. Other record types are ignored. */
+        virtual void addHead(keyType elem, uint8_t * const head, ups_txn_t *tr) override;
+
+        /** Removes the elem. */
+        void remove(payloadType pt, keyType elem, ups_txn_t *tr);
+
+        /** Appends at most max keys of the type not less than from into result
+         * in ascending order.
+        @return the number of keys appended. */
+        size_t collect(payloadType pt, keyType from, size_t max, std::deque<keyType> &result, ups_txn_t *tr);
+
+        /** Returns the number of elems of the type by scanning its index entries. */
+        size_t count(payloadType pt, ups_txn_t *tr);
+
+        /** Fills counts with the number of elems of each type present in one scan. */
+        void countAll(std::map<payloadType, size_t> &counts, ups_txn_t *tr);
+
+    protected:
+        /** Assembles the key. */
+        static IndexKey makeKey(payloadType pt, keyType elem);
+    };
+
+    /** Map of application-defined external IDs to node keys. Each mapped node has
+    the entry (IXI_ID, external ID) with the node key as record, and the entry
+    (IXI_ELEM, node key) with the external ID as record for removal. The external
+    IDs are assembled with the IndexKey operators, so both strings and numbers
+    can be used. */
+    class ExternalIdIndex final : public Index {
+    protected:
+        /** Kinds of entries, the first byte of the key. */
+        enum ExternalIdEntry : uint8_t {
+            IXI_ID, IXI_ELEM
+        };
+
+    public:
+        /** Sets the database name. */
+        ExternalIdIndex() noexcept : Index(DBN_EXTERNAL_IDS) {}
+
+        /** Maps the external ID to the node. */
+        void add(const IndexKey &externalId, keyType node, ups_txn_t *tr);
+
+        /** Looks up the node key of the external ID.
+        @return false if the external ID is not mapped. */
+        bool lookup(const IndexKey &externalId, keyType &node, ups_txn_t *tr);
+
+        /** Removes the mapping of the node if any. */
+        void remove(keyType node, ups_txn_t *tr);
+
+    protected:
+        /** Assembles the key of the lookup entry. */
+        static IndexKey makeIdKey(const IndexKey &externalId);
+
+        /** Assembles the key of the reverse entry. */
+        static IndexKey makeElemKey(keyType node);
+    };
+
+    /** Bounds and direction of an ordered scan over a FieldIndex. The values are
+    compared byte-wise, which follows the natural order for values appended with
+    the IndexKey operators. */
+    class FieldRange final {
+    public:
+        /** The smallest value to return if hasFrom is set. */
+        IndexKey from;
+
+        /** True if from is in effect. */
+        bool hasFrom = false;
+
+        /** The largest value to return if hasTo is set. */
+        IndexKey to;
+
+        /** True if to is in effect. */
+        bool hasTo = false;
+
+        /** Only values beginning with these bytes are returned, empty for all. */
+        IndexKey prefix;
+
+        /** True for descending value order. */
+        bool descending = false;
+
+        /** All values. */
+        static FieldRange all(bool desc = false);
+
+        /** Values between f and t inclusive. */
+        static FieldRange between(const IndexKey &f, const IndexKey &t, bool desc = false);
+
+        /** Values not less than f. */
+        static FieldRange atLeast(const IndexKey &f, bool desc = false);
+
+        /** Values not greater than t. */
+        static FieldRange atMost(const IndexKey &t, bool desc = false);
+
+        /** String values beginning with pref. */
+        static FieldRange startingWith(const std::string &pref, bool desc = false);
+    };
+
+    /** Kinds of the payload indexes, stored in their descriptors. */
+    enum PayloadIndexKind : uint8_t {
+        PIK_FIELD, PIK_GEO, PIK_VECTOR, PIK_EDGE_ORDER, PIK_AGGREGATE
+    };
+
+    /** Base class of the indexes maintained from the deserialized payloads of one
+    payload type. Such an index is updated on each write of an elem of the type. */
+    class PayloadIndex : public Index {
+    protected:
+        /** The kind of the index. */
+        PayloadIndexKind kind;
+
+        /** The registration order id among the indexes of the same kind. */
+        uint16_t id;
+
+        /** The payload type to index. */
+        payloadType type;
+
+    public:
+        /** Sets the database name from the first name of the kind and the
+         * registration order id, and the payload type. */
+        PayloadIndex(PayloadIndexKind k, DatabaseName first, uint16_t i, payloadType pt) noexcept :
+            Index(static_cast<DatabaseName>(first + i)), kind(k), id(i), type(pt) {}
+
+        /** Returns the indexed payload type. */
+        payloadType getType() const noexcept { return type; }
+
+        /** Returns the descriptor stored with the index to check if the index
+         * registrations still match the database: the kind, the payload type
+         * and the registration order id. */
+        virtual IndexKey describe() const;
+
+        /** Indexes the actual content of pl for the elem described by head, replacing
+        its old entries if any. */
+        virtual void update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) = 0;
+
+        /** Removes the elem from the index. */
+        virtual void remove(keyType elem, ups_txn_t *tr) = 0;
+
+    protected:
+        /** Appends the elem keys of at most max entries in range into result in the
+         * order of the range, for keys (base, value, elem). The scan starts after the
+         * entry in resume if it is not empty, and resume is set to the last entry read.
+        @param accept if set, only the entries whose record it accepts are returned.
+        @return the number of keys appended, less than max at the end of the range. */
+        size_t collectRange(const IndexKey &base, const FieldRange &range, IndexKey &resume, size_t max, std::deque<keyType> &result,
+            ups_txn_t *tr, const std::function<bool(const IndexKey&)> &accept = nullptr);
+    };
+
+    /** Descriptors of the payload indexes, each with the key (database name)
+    and the result of PayloadIndex::describe as record. The payload index names
+    follow the order of registration, so a different order or set of registrations
+    is detected on open instead of mixing up the indexes. */
+    class IndexDescriptors final : public Index {
+    public:
+        /** Sets the database name. */
+        IndexDescriptors() noexcept : Index(DBN_INDEX_DESCRIPTORS) {}
+
+        /** Compares the stored descriptor of the index to the actual one, or stores
+         * the actual one if missing.
+        @return false if they differ. */
+        bool verify(const PayloadIndex &index, ups_txn_t *tr);
+    };
+
+    /** Index of the values extracted from the payloads of one payload type. Each
+    indexed elem has two entries: the key (IFV_VALUE, value, elem) with empty record
+    for the lookups, and the key (IFV_ELEM, elem) with the value as record to find
+    the entry to remove when the value changes. */
+    class FieldIndex final : public PayloadIndex {
+    protected:
+        /** Kinds of entries, the first byte of the key. */
+        enum FieldEntry : uint8_t {
+            IFV_VALUE, IFV_ELEM
+        };
+
+        /** The value extractor. */
+        std::shared_ptr<FieldExtractor> extractor;
+
+    public:
+        /** Sets the database name from the registration order id. */
+        FieldIndex(uint16_t id, payloadType pt, std::shared_ptr<FieldExtractor> ex) noexcept :
+            PayloadIndex(PIK_FIELD, DBN_FIELD_FIRST, id, pt), extractor(ex) {}
+
+        /** Returns the extractor. */
+        FieldExtractor& getExtractor() noexcept { return *extractor; }
+
+        /** Indexes the actual value of pl for the elem, replacing its old value if any. */
+        virtual void update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) override;
+
+        /** Removes the elem from the index. */
+        virtual void remove(keyType elem, ups_txn_t *tr) override;
+
+        /** Appends the keys of the elems having exactly value into result in key order.
+        @return the number of keys appended. */
+        size_t lookup(const IndexKey &value, std::deque<keyType> &result, ups_txn_t *tr);
+
+        /** Appends the keys of the elems having a value between from and to inclusive
+         * into result in value order.
+        @return the number of keys appended. */
+        size_t lookupRange(const IndexKey &from, const IndexKey &to, std::deque<keyType> &result, ups_txn_t *tr);
+
+        /** Appends the keys of at most max elems in range into result in the order
+         * of the range. The scan starts after the entry in resume if it is not empty,
+        and resume is set to the last entry read, so consecutive calls stream the range.
+        @return the number of keys appended, less than max at the end of the range. */
+        size_t collect(const FieldRange &range, IndexKey &resume, size_t max, std::deque<keyType> &result, ups_txn_t *tr);
+
+    protected:
+        /** Assembles the lookup key. */
+        static IndexKey makeValueKey(const IndexKey &value, keyType elem);
+
+        /** Assembles the key of the entry holding the actual value. */
+        static IndexKey makeElemKey(keyType elem);
+    };
+
+    /** Spatial index of the positions extracted from the payloads of one payload
+    type. The positions are mapped to a 2^32 x 2^32 grid, and the cell coordinates
+    are interleaved into a Z-order code, so each quadtree cell is a contiguous key
+    range. Each indexed elem has the key (IGE_CELL, code, elem) with the position
+    as record for the queries, and the key (IGE_ELEM, elem) with the code and
+    position as record for the removal. */
+    class GeoIndex final : public PayloadIndex {
+    protected:
+        /** Kinds of entries, the first byte of the key. */
+        enum GeoEntry : uint8_t {
+            IGE_CELL, IGE_ELEM
+        };
+
+        /** The position extractor. */
+        std::shared_ptr<GeoExtractor> extractor;
+
+    public:
+        /** Mean radius of the Earth in meters. */
+        static constexpr double earthRadius = 6371008.8;
+
+        /** Sets the database name from the registration order id. */
+        GeoIndex(uint16_t id, payloadType pt, std::shared_ptr<GeoExtractor> ex) noexcept :
+            PayloadIndex(PIK_GEO, DBN_GEO_FIRST, id, pt), extractor(ex) {}
+
+        /** Indexes the actual position of pl for the elem, replacing its old one if any. */
+        virtual void update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) override;
+
+        /** Removes the elem from the index. */
+        virtual void remove(keyType elem, ups_txn_t *tr) override;
+
+        /** Appends the keys of the elems inside the box into keys. If minLon is
+         * greater than maxLon, the box crosses the antimeridian.
+        @param positions if not nullptr, the latitude and longitude of each key are appended.
+        @return the number of keys appended. */
+        size_t collectBox(double minLat, double minLon, double maxLat, double maxLon, std::deque<keyType> &keys,
+            std::deque<std::pair<double, double>> *positions, ups_txn_t *tr);
+
+        /** Appends the keys of the at most k elems nearest to the position into keys
+         * in ascending order of distance, and the distances in meters into distances.
+        The search scans boxes of growing size around the position until k elems are
+        found within the radius covered by the box. */
+        void nearest(double latitude, double longitude, size_t k, std::deque<keyType> &keys, std::deque<double> &distances, ups_txn_t *tr);
+
+        /** Returns the great-circle distance of two positions in meters. */
+        static double distance(double lat1, double lon1, double lat2, double lon2);
+
+    protected:
+        /** Returns the grid row of the latitude. */
+        static uint32_t gridLat(double latitude);
+
+        /** Returns the grid column of the longitude. */
+        static uint32_t gridLon(double longitude);
+
+        /** Interleaves the bits of x and y, x taking the even bits. */
+        static uint64_t interleave(uint32_t x, uint32_t y);
+
+        /** Collects the box not crossing the antimeridian. */
+        size_t collectSimpleBox(double minLat, double minLon, double maxLat, double maxLon, std::deque<keyType> &keys,
+            std::deque<std::pair<double, double>> *positions, ups_txn_t *tr);
+
+        /** Assembles the key of the entry used by the queries. */
+        static IndexKey makeCellKey(uint64_t cell, keyType elem);
+
+        /** Assembles the key of the entry holding the actual position. */
+        static IndexKey makeElemKey(keyType elem);
+    };
+
+    /** Approximate nearest neighbour index of the vectors extracted from the payloads
+     * of one payload type, a hierarchical navigable small world (HNSW) graph stored
+     * in its own database. Each indexed elem has a level drawn from its key, and
+     * a neighbour list on each layer from 0 to its level. The entries are:
+     * (IVE_VECTOR, elem) with the level and the vector as record, (IVE_LEVEL, level, elem)
+     * with empty record to find the entry point on the top layer, (IVE_LINKS, elem, layer)
+    with the neighbour keys as record, and (IVE_BACKLINK, neighbour, layer, elem) with
+    empty record for each neighbour, so all lists linking to a removed elem can be
+    repaired, also the one-way ones. The vectors are stored in native byte order. */
+    class VectorIndex final : public PayloadIndex {
+    public:
+        /** Registration data of a vector index, see GEFactory::regVectorIndex. */
+        struct Params {
+            /** The payload type to index. */
+            payloadType type;
+
+            /** The vector extractor. */
+            std::shared_ptr<VectorExtractor> extractor;
+
+            /** Distance function. */
+            VectorMetric metric;
+
+            /** Maximum number of neighbours on the upper layers, the double on layer 0. */
+            uint16_t maxLinks;
+
+            /** Size of the candidate list when inserting. */
+            uint16_t efConstruction;
+
+            /** Default size of the candidate list when searching. */
+            uint16_t efSearch;
+        };
+
+    protected:
+        /** Kinds of entries, the first byte of the key. */
+        enum VectorEntry : uint8_t {
+            IVE_VECTOR, IVE_LEVEL, IVE_LINKS, IVE_BACKLINK
+        };
+
+        /** Distance and key of an elem. */
+        typedef std::pair<float, keyType> Scored;
+
+        /** Vectors read during one operation. */
+        typedef std::unordered_map<keyType, std::vector<float>> VectorCache;
+
+        /** Registration data. */
+        Params params;
+
+    public:
+        /** Sets the database name from the registration order id. */
+        VectorIndex(uint16_t id, const Params &p) noexcept :
+            PayloadIndex(PIK_VECTOR, DBN_VECTOR_FIRST, id, p.type), params(p) {}
+
+        /** Appends the metric and the maximum number of links to the common
+         * descriptor, as the stored graph depends on them. */
+        virtual IndexKey describe() const override;
+
+        /** Indexes the actual vector of pl for the elem, replacing its old one if it has changed.
+        @throws IllegalArgumentException if the dimension differs from that of the indexed vectors. */
+        virtual void update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) override;
+
+        /** Removes the elem from the index. The elems linking to it and its
+        neighbours get new neighbours from its list to keep the layers navigable. */
+        virtual void remove(keyType elem, ups_txn_t *tr) override;
+
+        /** Appends the keys of the approximately k elems nearest to the query into keys
+         * in ascending order of distance, and the distances into distances.
+        @param ef size of the candidate list, 0 means Params::efSearch. At least k is used. */
+        void nearest(const std::vector<float> &query, size_t k, size_t ef, std::deque<keyType> &keys, std::deque<double> &distances, ups_txn_t *tr);
+
+        /** Returns the distance of two vectors of size dim according to the metric. */
+        static float distance(VectorMetric metric, const float * const a, const float * const b, size_t dim);
+
+    protected:
+        /** Returns the level of the elem, derived from its key with the usual
+        exponentially decaying distribution. */
+        uint8_t levelOf(keyType elem) const;
+
+        /** Returns the maximum number of neighbours on the layer. */
+        size_t maxLinksOn(uint8_t layer) const { return layer == 0 ? 2u * params.maxLinks : params.maxLinks; }
+
+        /** Finds the entry point, the elem with the highest level.
+        @return false if the index is empty. */
+        bool entryPoint(keyType &elem, uint8_t &level, ups_txn_t *tr);
+
+        /** Returns the vector of the elem from the cache or the database, nullptr if not indexed. */
+        const std::vector<float>* getVector(keyType elem, VectorCache &cache, ups_txn_t *tr);
+
+        /** Reads the neighbours of the elem on the layer. */
+        void readLinks(keyType elem, uint8_t layer, std::vector<keyType> &links, ups_txn_t *tr);
+
+        /** Writes the neighbours of the elem on the layer and updates their backlinks.
+         * An empty list is erased. */
+        void writeLinks(keyType elem, uint8_t layer, const std::vector<keyType> &links, ups_txn_t *tr);
+
+        /** Reads the elems linking to the elem on the layer. */
+        void readBacklinks(keyType elem, uint8_t layer, std::vector<keyType> &sources, ups_txn_t *tr);
+
+        /** Greedy beam search on a layer. found holds the entry points on call and
+        the at most ef nearest elems found in ascending order of distance on return. */
+        void searchLayer(const std::vector<float> &query, std::vector<Scored> &found, size_t ef, uint8_t layer, VectorCache &cache, ups_txn_t *tr);
+
+        /** Selects at most max neighbours from the candidates sorted by distance,
+         * preferring ones not closer to an already selected neighbour than to the
+        base, and fills up with the skipped ones. */
+        void selectNeighbours(const std::vector<Scored> &candidates, size_t max, std::vector<keyType> &selected, VectorCache &cache, ups_txn_t *tr);
+
+        /** Adds the link to the neighbour list of the elem, shrinking the list if it becomes too long. */
+        void addLink(keyType elem, keyType link, uint8_t layer, VectorCache &cache, ups_txn_t *tr);
+
+        /** Inserts the vector of a new elem. */
+        void insertVector(keyType elem, const std::vector<float> &vec, ups_txn_t *tr);
+
+        /** Assembles the key of the entry holding the vector. */
+        static IndexKey makeVectorKey(keyType elem);
+
+        /** Assembles the key of the entry holding the neighbours on a layer. */
+        static IndexKey makeLinksKey(keyType elem, uint8_t layer);
+
+        /** Assembles the key of the level entry. */
+        static IndexKey makeLevelKey(uint8_t level, keyType elem);
+
+        /** Assembles the key of the entry telling that source links to elem on the layer. */
+        static IndexKey makeBacklinkKey(keyType elem, uint8_t layer, keyType source);
+    };
+
+    /** Ordered adjacency lists of the edges of one payload type by a value extracted
+     * from the edge payload, for example a timestamp, so the first or last N edges
+     * of a node can be read without loading all of them. Each indexed edge has the
+     * key (IEO_LIST, node, value, edge) at both of its nodes with the end bits and
+     * the other node as record, and the key (IEO_EDGE, edge) with the nodes, the
+    record type and the value as record to find the entries to remove. */
+    class EdgeOrderIndex final : public PayloadIndex {
+    protected:
+        /** Kinds of entries, the first byte of the key. */
+        enum OrderEntry : uint8_t {
+            IEO_LIST, IEO_EDGE
+        };
+
+        /** The sort value extractor. */
+        std::shared_ptr<FieldExtractor> extractor;
+
+    public:
+        /** Sets the database name from the registration order id. */
+        EdgeOrderIndex(uint16_t id, payloadType pt, std::shared_ptr<FieldExtractor> ex) noexcept :
+            PayloadIndex(PIK_EDGE_ORDER, DBN_EDGE_ORDER_FIRST, id, pt), extractor(ex) {}
+
+        /** Inserts the edge into the lists of its nodes, or moves it if its value
+        has changed. Nodes are ignored. */
+        virtual void update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) override;
+
+        /** Removes the edge from the lists of its nodes. */
+        virtual void remove(keyType elem, ups_txn_t *tr) override;
+
+        /** Appends the keys of at most max edges of the node in range into result
+         * in the order of the range, streaming like FieldIndex::collect.
+        @param ends the EdgeEndBits the node must have in the edge.
+        @return the number of keys appended, less than max at the end of the range. */
+        size_t collect(keyType node, uint8_t ends, const FieldRange &range, IndexKey &resume, size_t max, std::deque<keyType> &result, ups_txn_t *tr);
+
+    protected:
+        /** Assembles the key of a list entry. */
+        static IndexKey makeListKey(keyType node, const IndexKey &value, keyType edge);
+
+        /** Assembles the key of the entry used for the removal. */
+        static IndexKey makeEdgeKey(keyType edge);
+
+        /** Inserts the list entry of the node. */
+        void insertEntry(keyType node, const IndexKey &value, keyType edge, uint8_t ends, keyType other, ups_txn_t *tr);
+    };
+
+    /** Count and sum of a value extracted from the edges of one payload type,
+     * maintained for each node and end of edge on every edge write and removal,
+     * so reading them costs a lookup instead of reading all edges. Each node has the
+     * key (IAG_NODE, node, end bit) with the count and sum as record, and each
+     * counted edge the key (IAG_EDGE, edge) with the nodes, the record type and the
+    value as record to subtract when the value changes. A loop is counted at both
+    of its ends like in Database::getDegree, so a directed one once as incoming and
+    once as outgoing, and an undirected one twice. The sums may accumulate
+    floating point rounding errors over many updates. */
+    class AggregateIndex final : public PayloadIndex {
+    protected:
+        /** Kinds of entries, the first byte of the key. */
+        enum AggregateEntry : uint8_t {
+            IAG_NODE, IAG_EDGE
+        };
+
+        /** The value extractor, nullptr for counting only. */
+        std::shared_ptr<ValueExtractor> extractor;
+
+    public:
+        /** Sets the database name from the registration order id. */
+        AggregateIndex(uint16_t id, payloadType pt, std::shared_ptr<ValueExtractor> ex) noexcept :
+            PayloadIndex(PIK_AGGREGATE, DBN_AGGREGATE_FIRST, id, pt), extractor(ex) {}
+
+        /** Adds the value of the edge to the aggregates of its nodes, replacing
+        its old value if any. Nodes are ignored. */
+        virtual void update(const HeadFields &head, const Payload * const pl, ups_txn_t *tr) override;
+
+        /** Subtracts the value of the edge from the aggregates of its nodes, or
+        removes the aggregates of a node. */
+        virtual void remove(keyType elem, ups_txn_t *tr) override;
+
+        /** Returns the aggregate of the edges of the node having any of the ends. */
+        EdgeAggregate get(keyType node, uint8_t ends, ups_txn_t *tr);
+
+    protected:
+        /** Assembles the key of the aggregate of a node. */
+        static IndexKey makeNodeKey(keyType node, uint8_t end);
+
+        /** Assembles the key of the entry holding the counted value of an edge. */
+        static IndexKey makeEdgeKey(keyType edge);
+
+        /** Adds count and value to the aggregate of the node. */
+        void add(keyType node, uint8_t end, int64_t count, double value, ups_txn_t *tr);
+
+        /** Adds count and value to the aggregates of both ends of the edge. */
+        void addEdge(keyType start, keyType end, RecordType rt, int64_t count, double value, ups_txn_t *tr);
+    };
+}
+
+#endif
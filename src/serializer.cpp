@@ -552,7 +552,20 @@ deque<keyType> RecordChain::getKeys() const {
 }
 
 void RecordChain::addEdge(FieldPosNode which, keyType key, ups_txn_t *tr) {
-    unordered_set<indexType> modifiedIndices = hashInsert(which, key);
+    unordered_set<indexType> modifiedIndices = hashInsert(which, &key, 1);
+    for(indexType i : modifiedIndices) {
+        content[i].save(db, tr);
+    }
+}
+
+void RecordChain::addEdges(FieldPosNode which, const deque<keyType> &keys, ups_txn_t *tr) {
+    if(keys.size() == 0) {
+        return;
+    }
+    keyType *array = new keyType[keys.size()];
+    AutoDeleter<keyType> deleteArray(array);
+    copy(keys.begin(), keys.end(), array);
+    unordered_set<indexType> modifiedIndices = hashInsert(which, array, keys.size());
     for(indexType i : modifiedIndices) {
         content[i].save(db, tr);
     }
@@ -958,25 +971,27 @@ indexType RecordChain::doInsert(FieldPosNode which, countType buckets, keyType k
     throw DebugException("Unable to insert key into hash.");
 }
 
-unordered_set<indexType> RecordChain::hashInsert(FieldPosNode which, keyType key) {
+unordered_set<indexType> RecordChain::hashInsert(FieldPosNode which, const keyType * const keys, countType count) {
     unordered_set<indexType> modifiedIndices;
     int hashStartInd = (which - FPN_IN_BUCKETS) / FR_SPAN;
     countType buckets = getHeadField(which);
     countType used = getHeadField(which + FR_USED);
     countType deleted = getHeadField(which + FR_DELETED);
-    if(used + deleted >= double(buckets) * 0.89) {
+    if(used + deleted + count - 1 >= double(buckets) * 0.89) {
         if(buckets == primes[primesLen - 1]) {
             // not too likely but who knows
             throw IllegalQuantityException("Too many edges for a node.");
         }
         // save the old contents
-        keyType *oldKeys = new keyType[used + 1];
+        keyType *oldKeys = new keyType[used + count];
+        AutoDeleter<keyType> deleteOldKeys(oldKeys);
         countType found = hashCollect(which, oldKeys);
         if(found != used) {
             throw DebugException("Hash content does not match \'used\' count.");
         }
-        // and append the new key
-        oldKeys[used++] = key;
+        // and append the new keys
+        copy(keys, keys + count, oldKeys + used);
+        used += count;
         // calculate the new bucket count, first try only one more record
         countType keysPerRecordNet = Record::getKeysPerRecord() - Record::hashStarts[RT_CONT];
         countType firstPrime = primes[0];
@@ -997,6 +1012,21 @@ unordered_set<indexType> RecordChain::hashInsert(FieldPosNode which, keyType key
             // the last one was right
             missingRecords = 1;
         }
+        if(count > 1) {
+            // bulk insert: grow at once to the final size
+            countType grown = static_cast<countType>(where);
+            while(grown < primesLen && used >= double(primes[grown]) * 0.89) {
+                grown++;
+            }
+            if(grown == primesLen) {
+                throw IllegalQuantityException("Too many edges for a node.");
+            }
+            if(grown != static_cast<countType>(where)) {
+                where = static_cast<int>(grown);
+                missingRecords = (primes[where] - firstPrime + keysPerRecordNet - 1) /
+                        keysPerRecordNet - recordsNow;
+            }
+        }
         bool wasSingle = buckets == primes[0];
         buckets = primes[where];
         // sets hashStart* as well
@@ -1031,8 +1061,8 @@ unordered_set<indexType> RecordChain::hashInsert(FieldPosNode which, keyType key
         // part if needed
         Record &beforeInsertPoint = content[firstRecord];
         if(wasSingle) {
-            // copy the stuff after this hashtable into it
-            Record &inserted = content[firstRecord + 1];
+            // copy the stuff after this hashtable into the last new record
+            Record &inserted = content[firstRecord + missingRecords];
             inserted.copyContent(beforeInsertPoint);
             if(firstRecord == 0) {
                 // we copied the head, restore the record type
@@ -1060,12 +1090,13 @@ unordered_set<indexType> RecordChain::hashInsert(FieldPosNode which, keyType key
         for(countType i = 0; i < used; i++) {
             doInsert(which, buckets, oldKeys[i], nullptr);
         }
-        delete[] oldKeys;
     }
     else {
-        // may decrement deleted
-        modifiedIndices.insert(doInsert(which, buckets, key, &deleted));
-        used++;
+        for(countType i = 0; i < count; i++) {
+            // may decrement deleted
+            modifiedIndices.insert(doInsert(which, buckets, keys[i], &deleted));
+        }
+        used += count;
     }
     // we need the head record, too
     modifiedIndices.insert(0);
@@ -552,6 +552,9 @@ ups_status_t _ups_db_find(ups_db_t *db, ups_txn_t *txn, ups_key_t *key, ups_reco
         is instantiated. */
         static void setRecordSize(size_t s);
 
+        /** Returns the record size. */
+        static countType getRecordSize() { return Record::getSize(); }
+
         /** Sets recordType. */
         RecordChain(RecordType rt, payloadType pt);
 
@@ -623,6 +626,11 @@ ups_status_t _ups_db_find(ups_db_t *db, ups_txn_t *txn, ups_key_t *key, ups_reco
          @param edgeKey the edge to be added to the hash table.*/
         void addEdge(FieldPosNode which, keyType edgeKey, ups_txn_t *tr);
 
+        /** Adds all the edges to the indicated array like addEdge, but grows the
+         * hash table at most once directly to its final size and writes each
+         * changed record only once. */
+        void addEdges(FieldPosNode which, const std::deque<keyType> &edgeKeys, ups_txn_t *tr);
+
         /** Removes all records after the one pointed by index. */
         void stripLeftover();
 
@@ -751,10 +759,11 @@ ups_status_t _ups_db_find(ups_db_t *db, ups_txn_t *txn, ups_key_t *key, ups_reco
          * @return the index of modified record. */
         indexType doInsert(FieldPosNode which, countType buckets, keyType key, countType * const deleted);
 
-        /** Inserts the key in the specified hash table, possibly rehashing its contents
-         * if the table is full enough: used + deleted >= double(buckets) * 0.89
+        /** Inserts the count keys in the specified hash table, possibly rehashing its
+         * contents if the table would be full enough: used + deleted >= double(buckets) * 0.89
+         * When rehashing more keys, the new size is chosen to hold all of them.
         @return the list of modified content indices. */
-        std::unordered_set<indexType> hashInsert(FieldPosNode which, keyType key);
+        std::unordered_set<indexType> hashInsert(FieldPosNode which, const keyType * const keys, countType count);
 
 #ifdef DEBUG
     public:
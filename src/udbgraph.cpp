@@ -2,6 +2,15 @@
 COPYRIGHT COMES HERE
 */
 
+#include<vector>
+#include<algorithm>
+#include<typeinfo>
+#include<thread>
+#include<atomic>
+#include<exception>
+#include<queue>
+#include<limits>
+#include<cmath>
 #include"udbgraph.h"
 
 #if USE_NVWA == 1
@@ -13,6 +22,53 @@ using namespace std;
 
 namespace udbgraph {
 
+    /** State of a running pattern search. */
+    class PatternSearch final {
+    public:
+        /** The pattern to find. */
+        const Pattern &pattern;
+
+        /** The transaction of the search. */
+        Transaction &tr;
+
+        /** See GraphElem::getEdges. */
+        bool omitFailed;
+
+        /** The found occurrences are appended here. */
+        deque<PatternMatch> &result;
+
+        /** The actual partial binding, unbound elements are empty. */
+        PatternMatch binding;
+
+        /** Keys of the bound nodes. */
+        unordered_set<keyType> boundNodes;
+
+        /** Keys of the bound edges. */
+        unordered_set<keyType> boundEdges;
+
+        /** True for the bound pattern edges. */
+        deque<bool> edgeDone;
+
+        /** Number of bound pattern edges. */
+        size_t doneCount = 0;
+
+        /** Degrees by node key and direction. */
+        map<pair<keyType, int>, countType> degrees;
+
+        /** Matching edges and their other ends by node key and 2 * pattern edge + side. */
+        map<pair<keyType, size_t>, deque<pair<shared_ptr<GraphElem>, keyType>>> steps;
+
+        /** Nodes by key and pattern node, empty if the node does not match. */
+        map<pair<keyType, size_t>, shared_ptr<GraphElem>> nodes;
+
+        /** Prepares an empty binding. */
+        PatternSearch(const Pattern &p, Transaction &t, bool o, deque<PatternMatch> &r) :
+            pattern(p), tr(t), omitFailed(o), result(r), edgeDone(p.getEdgeCount(), false) {
+            binding.nodes.resize(p.getNodeCount());
+            binding.edges.resize(p.getEdgeCount());
+        }
+    };
+
     string toString(GEState s) {
         switch(s) {
         case GEState::INV:
@@ -80,13 +136,20 @@ void Database::create(const char *filename, uint32_t mode, size_t recordSize) {
 //        {UPS_PARAM_RECORD_COMPRESSION, 1},
         {0, 0}
     };
-    ups_status_t st = ups_env_create_db(env, &db, 1, flags, param2);
+    ups_status_t st = ups_env_create_db(env, &db, DBN_GRAPH, flags, param2);
     if(st) {
         // try to free env, its result is not interesting any more
         flags = UPS_TXN_AUTO_ABORT;
         ups_env_close(env, flags);
         check(st);
     }
+    try {
+        openIndexes(true);
+    }
+    catch(UpsException &e) {
+        ups_env_close(env, UPS_TXN_AUTO_ABORT);
+        throw;
+    }
     RecordChain::setRecordSize(recordSize);
     keyGen = new KeyGenerator<keyType>(KEY_ROOT);
     shared_ptr<GraphElem> root(new Root(shared_from_this(), verMajor, verMinor, appName));
@@ -110,7 +173,7 @@ void Database::open(const char *filename) {
     };
     check(ups_env_open(&env, filename, flags, param));
     flags = 0;
-    ups_status_t st = ups_env_open_db(env, &db, 1, flags, nullptr);
+    ups_status_t st = ups_env_open_db(env, &db, DBN_GRAPH, flags, nullptr);
     if(st) {
         // try to free env, its result is not interesting any more
         flags = UPS_TXN_AUTO_ABORT;
@@ -128,6 +191,14 @@ void Database::open(const char *filename) {
     check(ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_FIRST));
     check(ups_cursor_close(cursor));
     RecordChain::setRecordSize(rec.size);
+    try {
+        openIndexes(false);
+    }
+    catch(...) {
+        ups_env_close(env, UPS_TXN_AUTO_ABORT);
+        delete keyGen;
+        throw;
+    }
     Transaction tr = doBeginTrans(TT::RO, true);
     bool matches = dynamic_pointer_cast<Root>(doRead(KEY_ROOT, tr, RCState::HEAD))->doesMatch(verMajor, verMinor, appName);
     doEndTrans(tr, TransactionEnd::ABORT_KEEP_PL);
@@ -168,6 +239,20 @@ void Database::write(shared_ptr<GraphElem> &ge, Transaction &tr) {
     doWrite(ge, tr);
 }
 
+void Database::write(deque<shared_ptr<GraphElem>> &elems) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RW, true);
+    doWrite(elems, tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::write(deque<shared_ptr<GraphElem>> &elems, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    doWrite(elems, tr);
+}
+
 void Database::attach(std::shared_ptr<GraphElem> ge, Transaction &tr, AttachMode am) {
     lock_guard<mutex> lck(accessMtx);
     isReady();
@@ -190,6 +275,109 @@ void Database::getRootEdges(QueryResult &res, EdgeEndType direction, Filter &flt
     doEndTrans(tr, TransactionEnd::COMMIT);
 }
 
+void Database::openIndexes(bool creating) {
+    setupPayloadIndexes();
+    if(creating || !indexDescriptors.open(env)) {
+        indexDescriptors.create(env);
+    }
+    deque<Index*> toBuild;
+    for(Index *index : getIndexes()) {
+        if(creating) {
+            index->create(env);
+        }
+        else if(!index->open(env)) {
+            index->create(env);
+            toBuild.push_back(index);
+        }
+    }
+    checkIndexDescriptors();
+    if(toBuild.size() > 0) {
+        buildIndexes(toBuild);
+    }
+}
+
+void Database::checkIndexDescriptors() {
+    ups_txn_t *upsTr;
+    check(ups_txn_begin(&upsTr, env, nullptr, nullptr, 0));
+    try {
+        for(PayloadIndex *payloadIndex : payloadIndexes) {
+            if(!indexDescriptors.verify(*payloadIndex, upsTr)) {
+                throw DatabaseException((string("Payload index registrations do not match the database at index database ") +
+                    to_string(payloadIndex->getName()) + ".").c_str());
+            }
+        }
+        check(ups_txn_commit(upsTr, 0));
+    }
+    catch(...) {
+        ups_txn_abort(upsTr, 0);
+        throw;
+    }
+}
+
+void Database::buildIndexes(deque<Index*> &toBuild) {
+    ups_txn_t *upsTr;
+    check(ups_txn_begin(&upsTr, env, nullptr, nullptr, 0));
+    ups_cursor_t *cursor = nullptr;
+    try {
+        ups_key_t key;
+        ups_record_t rec;
+        memset(&key, 0, sizeof(key));
+        memset(&rec, 0, sizeof(rec));
+        check(ups_cursor_create(&cursor, db, upsTr, 0));
+        // payload indexes need the payload, so their elems are read after the scan
+        deque<PayloadIndex*> payloadsToBuild;
+        for(Index *index : toBuild) {
+            PayloadIndex *payloadIndex = dynamic_cast<PayloadIndex*>(index);
+            if(payloadIndex != nullptr) {
+                payloadsToBuild.push_back(payloadIndex);
+            }
+        }
+        deque<keyType> toRead;
+        // the cursor memory may be reused by the inserts, so work on a copy
+        unique_ptr<uint8_t[]> head(new uint8_t[RecordChain::getRecordSize()]);
+        ups_status_t st = ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_FIRST);
+        while(st == UPS_SUCCESS) {
+            keyType headKey = *reinterpret_cast<keyType*>(key.data);
+            memcpy(head.get(), rec.data, rec.size);
+            for(Index *index : toBuild) {
+                index->addHead(headKey, head.get(), upsTr);
+            }
+            RecordType rt = static_cast<RecordType>(head[FP_RECORDTYPE]);
+            if(rt == RT_NODE || rt == RT_DEDGE || rt == RT_UEDGE) {
+                payloadType pt = static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head.get()));
+                for(PayloadIndex *payloadIndex : payloadsToBuild) {
+                    if(payloadIndex->getType() == pt) {
+                        toRead.push_back(headKey);
+                        break;
+                    }
+                }
+            }
+            st = ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_NEXT);
+        }
+        if(st != UPS_KEY_NOT_FOUND) {
+            check(st);
+        }
+        check(ups_cursor_close(cursor));
+        cursor = nullptr;
+        for(keyType elemKey : toRead) {
+            shared_ptr<GraphElem> ge = doBareRead(elemKey, RCState::FULL, upsTr);
+            for(PayloadIndex *payloadIndex : payloadsToBuild) {
+                if(payloadIndex->getType() == ge->pl()->getType()) {
+                    payloadIndex->update(ge->getHeadFields(), ge->pl(), upsTr);
+                }
+            }
+        }
+        check(ups_txn_commit(upsTr, 0));
+    }
+    catch(UpsException &e) {
+        if(cursor != nullptr) {
+            ups_cursor_close(cursor);
+        }
+        ups_txn_abort(upsTr, 0);
+        throw;
+    }
+}
+
 void Database::doAttach(std::shared_ptr<GraphElem> ge, Transaction &tr, AttachMode am) {
     keyType key = ge->getKey();
     transHandleType trHandle = tr.getHandle();
@@ -238,6 +426,10 @@ void Database::doClose() {
         ready = false;
         uint32_t flags = 0;
         db = nullptr;
+        for(Index *index : getIndexes()) {
+            index->close();
+        }
+        indexDescriptors.close();
         flags = UPS_TXN_AUTO_ABORT | UPS_AUTO_CLEANUP;
         ups_status_t st = ups_env_close(env, flags);
         env = nullptr;
@@ -264,6 +456,9 @@ Transaction Database::doBeginTrans(TransactionType trType, bool alreadyLocked) {
     transHandleType trHandle = tr.getHandle();
     // insert UpscaleDB transaction
     upsTransactions.insert(pair<transHandleType, ups_txn_t*>(trHandle, h));
+    if(trType != TT::RO) {
+        readWriteTransCount++;
+    }
     // insert an empty map for future transaction member storage
     lockedElemsMapType newMap;
     transLockedElems.insert(pair<transHandleType, lockedElemsMapType>(trHandle, newMap));
@@ -292,6 +487,9 @@ void Database::doEndTrans(Transaction &tr, TransactionEnd te) {
     // clean up before reporting the error if any
     // delete from the map containing UpscaleDB transactions
     upsTransactions.erase(trHandle);
+    if(!tr.isReadonly()) {
+        readWriteTransCount--;
+    }
     // delete from all locked graph elements
     for(auto &kv : foundLockedElems->second) {
         kv.second->endTrans(te);
@@ -346,7 +544,11 @@ void Database::checkAlienBeforeWrite(deque<keyType> &toCheck, Transaction &tr) c
 }
 
 void Database::checkACL(shared_ptr<GraphElem> &ge, Transaction &tr) const {
-    if(ge->getACLkey() != static_cast<keyType>(ACL_FREE)) {
+    checkACL(ge->getACLkey(), tr);
+}
+
+void Database::checkACL(keyType aclKey, Transaction &tr) const {
+    if(aclKey != static_cast<keyType>(ACL_FREE)) {
         throw PermissionException("Not authorized for an operation on an elem.");
     }
 }
@@ -389,8 +591,7 @@ void Database::registerElem(shared_ptr<GraphElem> &ge, transLockedElemsMapType::
     }
 }
 
-shared_ptr<GraphElem> Database::doBareRead(keyType key, RCState level, ups_txn_t *upsTr) {
-    // first try to read the head record
+uint8_t* Database::findHead(keyType key, ups_txn_t *upsTr) {
     ups_key_t upsKey;
     ups_record_t upsRecord;
     upsKey.flags = upsKey._flags = 0;
@@ -404,7 +605,34 @@ shared_ptr<GraphElem> Database::doBareRead(keyType key, RCState level, ups_txn_t
         throw ExistenceException("Requested graph element not found in the database.");
     }
     check(result);
-    RecordType recType = static_cast<RecordType>(FixedFieldIO::getField(FP_RECORDTYPE, reinterpret_cast<uint8_t *>(upsRecord.data)));
+    return reinterpret_cast<uint8_t *>(upsRecord.data);
+}
+
+uint8_t* Database::checkUnregisteredRead(keyType key, Transaction &tr) {
+    transHandleType trHandle = tr.getHandle();
+    transLockedElemsMapType::iterator foundLockedElems = getCheckTransLocked(trHandle);
+    if(allLockedElems.find(key) != allLockedElems.end() &&
+            foundLockedElems->second.find(key) == foundLockedElems->second.end()) {
+        // somebody else owns it
+        checkKeyVsTrans(key, tr);
+    }
+    // the changes of our own transaction are already saved, so the head is up-to-date
+    uint8_t *head = findHead(key, upsTransactions.find(trHandle)->second);
+    checkACL(static_cast<keyType>(FixedFieldIO::getField(FP_ACL, head)), tr);
+    return head;
+}
+
+shared_ptr<GraphElem> Database::doBareRead(keyType key, RCState level, ups_txn_t *upsTr) {
+    shared_ptr<GraphElem> ret = doBareHead(key, upsTr);
+    ret->read(upsTr, level);
+    ret->deserialize();
+    return ret;
+}
+
+shared_ptr<GraphElem> Database::doBareHead(keyType key, ups_txn_t *upsTr) {
+    // first try to read the head record
+    uint8_t *head = findHead(key, upsTr);
+    RecordType recType = static_cast<RecordType>(FixedFieldIO::getField(FP_RECORDTYPE, head));
     shared_ptr<GraphElem> ret;
     if(recType == RT_ROOT) {
         // does not compile with make_shared for some reason
@@ -412,13 +640,11 @@ shared_ptr<GraphElem> Database::doBareRead(keyType key, RCState level, ups_txn_t
         ret = move(root);
     }
     else {
-        payloadType plType = FixedFieldIO::getField(FP_PAYLOADTYPE, reinterpret_cast<uint8_t *>(upsRecord.data));
+        payloadType plType = FixedFieldIO::getField(FP_PAYLOADTYPE, head);
         shared_ptr<Database> db = shared_from_this();
         ret = GEFactory::create(db, plType);
     }
-    ret->setHead(key, reinterpret_cast<uint8_t *>(upsRecord.data));
-    ret->read(upsTr, level);
-    ret->deserialize();
+    ret->setHead(key, head);
     return ret;
 }
 
@@ -501,6 +727,153 @@ void Database::doWrite(shared_ptr<GraphElem> &ge, Transaction &tr) {
         // if passed, it is sure we already own the elem
     }
     ge->write(affected, upsTr);
+    if(state == GEState::DU && ge->getType() != RT_ROOT) {
+        types.add(ge->pl()->getType(), key, upsTr);
+    }
+    updatePayloadIndexes(ge, upsTr);
+}
+
+void Database::setupPayloadIndexes() {
+    payloadIndexes.clear();
+    fieldIndexes.clear();
+    geoIndexes.clear();
+    vectorIndexes.clear();
+    edgeOrderIndexes.clear();
+    aggregateIndexes.clear();
+    lock_guard<mutex> lck(GEFactory::typeMtx);
+    for(size_t i = 0; i < GEFactory::fieldIndexes.size(); i++) {
+        auto &reg = GEFactory::fieldIndexes[i];
+        fieldIndexes.push_back(unique_ptr<FieldIndex>(new FieldIndex(static_cast<uint16_t>(i), reg.first, reg.second)));
+        payloadIndexes.push_back(fieldIndexes.back().get());
+    }
+    for(size_t i = 0; i < GEFactory::geoIndexes.size(); i++) {
+        auto &reg = GEFactory::geoIndexes[i];
+        geoIndexes.push_back(unique_ptr<GeoIndex>(new GeoIndex(static_cast<uint16_t>(i), reg.first, reg.second)));
+        payloadIndexes.push_back(geoIndexes.back().get());
+    }
+    for(size_t i = 0; i < GEFactory::vectorIndexes.size(); i++) {
+        vectorIndexes.push_back(unique_ptr<VectorIndex>(new VectorIndex(static_cast<uint16_t>(i), GEFactory::vectorIndexes[i])));
+        payloadIndexes.push_back(vectorIndexes.back().get());
+    }
+    for(size_t i = 0; i < GEFactory::edgeOrders.size(); i++) {
+        auto &reg = GEFactory::edgeOrders[i];
+        edgeOrderIndexes.push_back(unique_ptr<EdgeOrderIndex>(new EdgeOrderIndex(static_cast<uint16_t>(i), reg.first, reg.second)));
+        payloadIndexes.push_back(edgeOrderIndexes.back().get());
+    }
+    for(size_t i = 0; i < GEFactory::aggregates.size(); i++) {
+        auto &reg = GEFactory::aggregates[i];
+        aggregateIndexes.push_back(unique_ptr<AggregateIndex>(new AggregateIndex(static_cast<uint16_t>(i), reg.first, reg.second)));
+        payloadIndexes.push_back(aggregateIndexes.back().get());
+    }
+}
+
+void Database::updatePayloadIndexes(shared_ptr<GraphElem> &ge, ups_txn_t *upsTr) {
+    if(payloadIndexes.size() == 0 || ge->getType() == RT_ROOT) {
+        return;
+    }
+    HeadFields head = ge->getHeadFields();
+    for(PayloadIndex *payloadIndex : payloadIndexes) {
+        if(payloadIndex->getType() == head.type) {
+            payloadIndex->update(head, ge->pl(), upsTr);
+        }
+    }
+}
+
+void Database::removeFromPayloadIndexes(keyType key, ups_txn_t *upsTr) {
+    for(PayloadIndex *payloadIndex : payloadIndexes) {
+        payloadIndex->remove(key, upsTr);
+    }
+}
+
+FieldIndex& Database::getFieldIndex(uint16_t indexId) {
+    if(indexId >= fieldIndexes.size()) {
+        throw DatabaseException((string("Unknown field index: ") + to_string(indexId)).c_str());
+    }
+    return *fieldIndexes[indexId];
+}
+
+void Database::findByField(QueryResult &res, uint16_t indexId, const IndexKey &value, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    doFindByField(res, indexId, value, nullptr, tr, omitFailed);
+}
+
+void Database::findByField(QueryResult &res, uint16_t indexId, const IndexKey &value, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    doFindByField(res, indexId, value, nullptr, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::findByFieldRange(QueryResult &res, uint16_t indexId, const IndexKey &from, const IndexKey &to, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    doFindByField(res, indexId, from, &to, tr, omitFailed);
+}
+
+void Database::findByFieldRange(QueryResult &res, uint16_t indexId, const IndexKey &from, const IndexKey &to, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    doFindByField(res, indexId, from, &to, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::doFindByField(QueryResult &res, uint16_t indexId, const IndexKey &from, const IndexKey *to, Transaction &tr, bool omitFailed) {
+    FieldIndex &fieldIndex = getFieldIndex(indexId);
+    ups_txn_t *upsTr = getUpsTrans(tr);
+    deque<keyType> found;
+    if(to == nullptr) {
+        fieldIndex.lookup(from, found, upsTr);
+    }
+    else {
+        fieldIndex.lookupRange(from, *to, found, upsTr);
+    }
+    // reading in key order helps locality
+    sort(found.begin(), found.end());
+    keyType *keys = new keyType[found.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    doGetElemsByKeys(res, keys, Filter::allpass(), tr, omitFailed);
+}
+
+void Database::doWrite(deque<shared_ptr<GraphElem>> &elems, Transaction &tr) {
+    bulkWrite = true;
+    try {
+        for(auto &ge : elems) {
+            doWrite(ge, tr);
+        }
+        bulkWrite = false;
+        flushPendingEdges(upsTransactions.find(tr.getHandle())->second);
+    }
+    catch(exception &e) {
+        bulkWrite = false;
+        pendingEdges.clear();
+        pendingNodes.clear();
+        throw;
+    }
+}
+
+void Database::addEdgeToNode(shared_ptr<GraphElem> &node, FieldPosNode where, keyType edge, ups_txn_t *tr) {
+    if(bulkWrite) {
+        keyType key = node->getKey();
+        pendingEdges[make_pair(key, where)].push_back(edge);
+        pendingNodes[key] = node;
+    }
+    else {
+        dynamic_pointer_cast<AbstractNode>(node)->addEdge(where, edge, tr);
+    }
+}
+
+void Database::flushPendingEdges(ups_txn_t *tr) {
+    for(auto &pending : pendingEdges) {
+        shared_ptr<GraphElem> &node = pendingNodes[pending.first.first];
+        dynamic_pointer_cast<AbstractNode>(node)->addEdges(pending.first.second, pending.second, tr);
+    }
+    pendingEdges.clear();
+    pendingNodes.clear();
 }
 
 void Database::getEdges(QueryResult &res, std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
@@ -552,155 +925,1981 @@ struct equal_to<shared_ptr<GraphElem>> {
     }
 };
 
-void Database::doGetEdges(QueryResult &queryResult, shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
-    // make sure the originating graph elem is a member of the transaction
-    doAttach(ge, tr, AM::KEEP_PL);
-    // For efficiency I use a simple array here.
-    const keyType *edgeKeys = ge->getEdgeKeys(direction);
-    // needed to ensure deletion even at exceptions
-    AutoDeleter<keyType> deleteKeys(edgeKeys);
-    transHandleType trHandle = tr.getHandle();
-    transLockedElemsMapType::iterator foundLockedElems = getCheckTransLocked(trHandle);
-    auto foundUpsTrans = upsTransactions.find(trHandle);
-    ups_txn_t *upsTr = foundUpsTrans->second;
-    const keyType *keyInd;
-    unordered_map<shared_ptr<GraphElem>, AfterCheck> checkResults;
-    // First gather graph elems and check them to allow possible exceptions be
-    // raised before we store the stuff in res
-    for(keyInd = edgeKeys; *keyInd != KEY_INVALID; keyInd++) {
-        lockedElemsMapType::iterator foundElem = allLockedElems.find(*keyInd);
-        shared_ptr<GraphElem> ge;
-        if(foundElem == allLockedElems.end()) {
-            // not found, we must read it from disk
-            try {
-                ge = doBareRead(*keyInd, RCState::FULL, upsTr);
-                checkACL(ge, tr);
-                checkResults[ge] = AfterCheck::JustRead;
-            }
-            catch(PermissionException &pe) {
-                if(!omitFailed) {
-                    throw;
-                }
-            }
-        }
-        else {
-            lockedElemsMapType::iterator foundInTr = foundLockedElems->second.find(*keyInd);
-            if(foundInTr != foundLockedElems->second.end()) {
-                // we own it, no more checks and registering
-                ge = foundInTr->second;
-                checkResults[ge] = AfterCheck::Ours;
-            }
-            else {
-                try {
-                    // somebody else owns it
-                    checkKeyVsTrans(*keyInd, tr);
-                    // now it is sure that this transaction is read-only and the one that
-                    // owns it is also read-only
-                    ge = foundElem->second;
-                    checkACL(ge, tr);
-                    checkResults[ge] = AfterCheck::Others;
-                }
-                catch(PermissionException &pe) {
-                    if(!omitFailed) {
-                        throw;
-                    }
-                }
-                catch(TransactionException &te) {
-                    if(!omitFailed) {
-                        throw;
-                    }
-                }
-            }
-        }
-    }
-    // read them fully if needed and perform filtering
-    for(auto &i : checkResults) {
-        AfterCheck checkResult = i.second;
-        shared_ptr<GraphElem> ge = i.first;
-        if(checkResult == AfterCheck::Ours || checkResult == AfterCheck::Others) {
-            ge->read(upsTr, RCState::FULL);
-            // if everything is read, and it is not root, we must deserialize it
-            // to make sure the payload reflects the disc contents
-            ge->deserialize();
-        }
-        if(fltEdge.match(ge->pl())) {
-            if(checkResult == AfterCheck::JustRead || checkResult == AfterCheck::Others) {
-                registerElem(ge, foundLockedElems, tr);
-            }
-            queryResult.insert(ge);
-        }
+GeoIndex& Database::getGeoIndex(uint16_t indexId) {
+    if(indexId >= geoIndexes.size()) {
+        throw DatabaseException((string("Unknown spatial index: ") + to_string(indexId)).c_str());
     }
+    return *geoIndexes[indexId];
 }
 
-void Database::doGetNeighbours(QueryResult &res, shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Filter &fltNode, Transaction &tr, bool omitFailed) {
-    // TODO implement only when doGetEdges is functional
-}
-
-shared_ptr<GraphElem> Database::getStart(shared_ptr<GraphElem> &ge, Transaction &tr) {
+void Database::findInBox(QueryResult &res, uint16_t indexId, double minLat, double minLon, double maxLat, double maxLon, Transaction &tr, bool omitFailed) {
     lock_guard<mutex> lck(accessMtx);
     isReady();
-    return ge->doGetStart(tr);
+    doFindInBox(res, indexId, minLat, minLon, maxLat, maxLon, tr, omitFailed);
 }
 
-shared_ptr<GraphElem> Database::getStart(shared_ptr<GraphElem> &ge) {
+void Database::findInBox(QueryResult &res, uint16_t indexId, double minLat, double minLon, double maxLat, double maxLon, bool omitFailed) {
     lock_guard<mutex> lck(accessMtx);
     isReady();
     Transaction tr = doBeginTrans(TT::RO, true);
-    shared_ptr<GraphElem> ret = ge->doGetStart(tr);
+    doFindInBox(res, indexId, minLat, minLon, maxLat, maxLon, tr, omitFailed);
     doEndTrans(tr, TransactionEnd::COMMIT);
-    return ret;
 }
 
-shared_ptr<GraphElem> Database::getEnd(shared_ptr<GraphElem> &ge, Transaction &tr) {
+void Database::doFindInBox(QueryResult &res, uint16_t indexId, double minLat, double minLon, double maxLat, double maxLon, Transaction &tr, bool omitFailed) {
+    GeoIndex &geoIndex = getGeoIndex(indexId);
+    deque<keyType> found;
+    geoIndex.collectBox(minLat, minLon, maxLat, maxLon, found, nullptr, getUpsTrans(tr));
+    // reading in key order helps locality
+    sort(found.begin(), found.end());
+    keyType *keys = new keyType[found.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    doGetElemsByKeys(res, keys, Filter::allpass(), tr, omitFailed);
+}
+
+void Database::findNearest(deque<shared_ptr<GraphElem>> &result, deque<double> &distances, uint16_t indexId, double latitude, double longitude, size_t k, Transaction &tr, bool omitFailed) {
     lock_guard<mutex> lck(accessMtx);
     isReady();
-    return ge->doGetEnd(tr);
+    doFindNearest(result, distances, indexId, latitude, longitude, k, tr, omitFailed);
 }
 
-shared_ptr<GraphElem> Database::getEnd(shared_ptr<GraphElem> &ge) {
+void Database::findNearest(deque<shared_ptr<GraphElem>> &result, deque<double> &distances, uint16_t indexId, double latitude, double longitude, size_t k, bool omitFailed) {
     lock_guard<mutex> lck(accessMtx);
     isReady();
     Transaction tr = doBeginTrans(TT::RO, true);
-    shared_ptr<GraphElem> ret = ge->doGetEnd(tr);
+    doFindNearest(result, distances, indexId, latitude, longitude, k, tr, omitFailed);
     doEndTrans(tr, TransactionEnd::COMMIT);
-    return ret;
 }
 
-/*ups_txn_t *Database::getUpsTr(Transaction &tr) {
-    auto foundUpsTrans = upsTransactions.find(tr.getHandle());
-    return foundUpsTrans->second;
-}*/
+void Database::doFindNearest(deque<shared_ptr<GraphElem>> &result, deque<double> &distances, uint16_t indexId, double latitude, double longitude, size_t k, Transaction &tr, bool omitFailed) {
+    GeoIndex &geoIndex = getGeoIndex(indexId);
+    deque<keyType> found;
+    deque<double> foundDistances;
+    geoIndex.nearest(latitude, longitude, k, found, foundDistances, getUpsTrans(tr));
+    keyType *keys = new keyType[found.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    QueryResult res;
+    doGetElemsByKeys(res, keys, Filter::allpass(), tr, omitFailed);
+    orderByKeys(res, found, foundDistances, result, distances);
+}
 
-keyType Database::getFirstFreeKey() {
-    ups_key_t key;
-    keyType needle = 0;
-    key.data = &needle;
-    key.flags = UPS_KEY_USER_ALLOC;
-    ups_record_t found;
-    int bitCount = (key.size = sizeof(keyType)) * 8;
-    for(int i = bitCount - 1; i >= 0; i--) {
-        keyType prevNeedle = needle;
-        needle |= (1 << i);
-        found.size = found.flags = found.partial_offset = found.partial_size = 0;
-        found.data = nullptr;
-        ups_status_t st = _ups_db_find(db, nullptr, &key, &found, UPS_FIND_GEQ_MATCH);
-        switch(st) {
-        case UPS_SUCCESS:
-            // nothing to do, needle already has the bit set.
-            break;
-        case UPS_KEY_NOT_FOUND:
-            // reset the previous value
-            needle = prevNeedle;
-            break;
-        default:
-            throw UpsException(st);
-        }
+VectorIndex& Database::getVectorIndex(uint16_t indexId) {
+    if(indexId >= vectorIndexes.size()) {
+        throw DatabaseException((string("Unknown vector index: ") + to_string(indexId)).c_str());
     }
-    return needle + 1;
+    return *vectorIndexes[indexId];
 }
 
-transHandleType Transaction::counter = TR_NOMORE;
-
+void Database::findSimilar(deque<shared_ptr<GraphElem>> &result, deque<double> &distances, uint16_t indexId, const vector<float> &query, size_t k, size_t ef, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    doFindSimilar(result, distances, indexId, query, k, ef, tr, omitFailed);
+}
+
+void Database::findSimilar(deque<shared_ptr<GraphElem>> &result, deque<double> &distances, uint16_t indexId, const vector<float> &query, size_t k, size_t ef, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    doFindSimilar(result, distances, indexId, query, k, ef, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::doFindSimilar(deque<shared_ptr<GraphElem>> &result, deque<double> &distances, uint16_t indexId, const vector<float> &query, size_t k, size_t ef, Transaction &tr, bool omitFailed) {
+    VectorIndex &vectorIndex = getVectorIndex(indexId);
+    deque<keyType> found;
+    deque<double> foundDistances;
+    vectorIndex.nearest(query, k, ef, found, foundDistances, getUpsTrans(tr));
+    keyType *keys = new keyType[found.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    QueryResult res;
+    doGetElemsByKeys(res, keys, Filter::allpass(), tr, omitFailed);
+    orderByKeys(res, found, foundDistances, result, distances);
+}
+
+void Database::orderByKeys(QueryResult &res, const deque<keyType> &keys, const deque<double> &values, deque<shared_ptr<GraphElem>> &result, deque<double> &resultValues) {
+    unordered_map<keyType, shared_ptr<GraphElem>> byKey;
+    for(auto &ge : res) {
+        byKey[ge->getKey()] = ge;
+    }
+    for(size_t i = 0; i < keys.size(); i++) {
+        auto found = byKey.find(keys[i]);
+        // omitted elems are missing
+        if(found != byKey.end()) {
+            result.push_back(found->second);
+            resultValues.push_back(values[i]);
+        }
+    }
+}
+
+void Database::doGetEdges(QueryResult &queryResult, shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    // For efficiency I use a simple array here.
+    const keyType *edgeKeys = doGetEdgeKeys(ge, direction, fltEdge, tr);
+    // needed to ensure deletion even at exceptions
+    AutoDeleter<keyType> deleteKeys(edgeKeys);
+    doGetElemsByKeys(queryResult, edgeKeys, fltEdge, tr, omitFailed);
+}
+
+keyType* Database::doGetEdgeKeys(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr) {
+    // make sure the originating graph elem is a member of the transaction
+    doAttach(ge, tr, AM::KEEP_PL);
+    payloadType pt = fltEdge.getPayloadType();
+    return pt == PT_ANY ? ge->getEdgeKeys(direction) :
+        doGetEdgeKeysOfType(ge->getKey(), direction, pt, tr);
+}
+
+EdgeCursor Database::getEdgeCursor(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, size_t limit, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return EdgeCursor(shared_from_this(), tr, fltEdge, doGetEdgeKeys(ge, direction, fltEdge, tr), limit, omitFailed);
+}
+
+shared_ptr<GraphElem> Database::cursorNext(EdgeCursor &cursor) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    keyType single[2];
+    single[1] = KEY_INVALID;
+    while(cursor.keys[cursor.position] != KEY_INVALID &&
+            (cursor.limit == 0 || cursor.returned < cursor.limit)) {
+        single[0] = cursor.keys[cursor.position++];
+        QueryResult found;
+        doGetElemsByKeys(found, single, cursor.fltEdge, cursor.tr, cursor.omitFailed);
+        if(found.size() > 0) {
+            cursor.returned++;
+            return *found.begin();
+        }
+    }
+    return shared_ptr<GraphElem>();
+}
+
+ExtentCursor Database::getExtentCursor(payloadType pt, Filter &flt, Transaction &tr, size_t limit, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    getUpsTrans(tr);
+    return ExtentCursor(shared_from_this(), tr, pt, flt, limit, omitFailed);
+}
+
+shared_ptr<GraphElem> Database::extentNext(ExtentCursor &cursor) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    keyType single[2];
+    single[1] = KEY_INVALID;
+    while(cursor.limit == 0 || cursor.returned < cursor.limit) {
+        if(cursor.keys.empty()) {
+            if(cursor.exhausted) {
+                break;
+            }
+            // a fresh index cursor for each batch, as the lock is released between calls
+            if(types.collect(cursor.type, cursor.nextKey, ExtentCursor::batchSize, cursor.keys, getUpsTrans(cursor.tr)) < ExtentCursor::batchSize) {
+                cursor.exhausted = true;
+            }
+            if(cursor.keys.empty()) {
+                break;
+            }
+            cursor.nextKey = cursor.keys.back() + 1;
+        }
+        single[0] = cursor.keys.front();
+        cursor.keys.pop_front();
+        QueryResult found;
+        doGetElemsByKeys(found, single, cursor.flt, cursor.tr, cursor.omitFailed);
+        if(found.size() > 0) {
+            cursor.returned++;
+            return *found.begin();
+        }
+    }
+    return shared_ptr<GraphElem>();
+}
+
+FieldCursor Database::getFieldCursor(uint16_t indexId, const FieldRange &range, Filter &flt, Transaction &tr, size_t limit, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    getFieldIndex(indexId);
+    getUpsTrans(tr);
+    return FieldCursor(shared_from_this(), tr, indexId, range, flt, limit, omitFailed);
+}
+
+shared_ptr<GraphElem> Database::fieldNext(FieldCursor &cursor) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    keyType single[2];
+    single[1] = KEY_INVALID;
+    while(cursor.limit == 0 || cursor.returned < cursor.limit) {
+        if(cursor.keys.empty()) {
+            if(cursor.exhausted) {
+                break;
+            }
+            FieldIndex &fieldIndex = getFieldIndex(cursor.indexId);
+            if(fieldIndex.collect(cursor.range, cursor.resume, FieldCursor::batchSize, cursor.keys, getUpsTrans(cursor.tr)) < FieldCursor::batchSize) {
+                cursor.exhausted = true;
+            }
+            if(cursor.keys.empty()) {
+                break;
+            }
+        }
+        single[0] = cursor.keys.front();
+        cursor.keys.pop_front();
+        QueryResult found;
+        doGetElemsByKeys(found, single, cursor.flt, cursor.tr, cursor.omitFailed);
+        if(found.size() > 0) {
+            cursor.returned++;
+            return *found.begin();
+        }
+    }
+    return shared_ptr<GraphElem>();
+}
+
+EdgeOrderIndex& Database::getEdgeOrderIndex(uint16_t indexId) {
+    if(indexId >= edgeOrderIndexes.size()) {
+        throw DatabaseException((string("Unknown edge order index: ") + to_string(indexId)).c_str());
+    }
+    return *edgeOrderIndexes[indexId];
+}
+
+OrderedEdgeCursor Database::getOrderedEdgeCursor(shared_ptr<GraphElem> &ge, uint16_t indexId, EdgeEndType direction, const FieldRange &range,
+        Filter &fltEdge, Transaction &tr, size_t limit, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    getEdgeOrderIndex(indexId);
+    // make sure the originating graph elem is a member of the transaction
+    doAttach(ge, tr, AM::KEEP_PL);
+    return OrderedEdgeCursor(shared_from_this(), tr, indexId, ge->getKey(), endBits(direction), range, fltEdge, limit, omitFailed);
+}
+
+shared_ptr<GraphElem> Database::orderedEdgeNext(OrderedEdgeCursor &cursor) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    keyType single[2];
+    single[1] = KEY_INVALID;
+    while(cursor.limit == 0 || cursor.returned < cursor.limit) {
+        if(cursor.keys.empty()) {
+            if(cursor.exhausted) {
+                break;
+            }
+            EdgeOrderIndex &edgeOrderIndex = getEdgeOrderIndex(cursor.indexId);
+            // fetching only what the limit may still need keeps recent-N queries short
+            size_t batch = OrderedEdgeCursor::batchSize;
+            if(cursor.limit > 0 && cursor.limit - cursor.returned < batch) {
+                batch = cursor.limit - cursor.returned;
+            }
+            if(edgeOrderIndex.collect(cursor.node, cursor.ends, cursor.range, cursor.resume, batch, cursor.keys, getUpsTrans(cursor.tr)) < batch) {
+                cursor.exhausted = true;
+            }
+            if(cursor.keys.empty()) {
+                break;
+            }
+        }
+        single[0] = cursor.keys.front();
+        cursor.keys.pop_front();
+        QueryResult found;
+        doGetElemsByKeys(found, single, cursor.fltEdge, cursor.tr, cursor.omitFailed);
+        if(found.size() > 0) {
+            cursor.returned++;
+            return *found.begin();
+        }
+    }
+    return shared_ptr<GraphElem>();
+}
+
+bool Database::upsertNode(const IndexKey &externalId, shared_ptr<GraphElem> &node, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doUpsertNode(externalId, node, tr);
+}
+
+bool Database::upsertNode(const IndexKey &externalId, shared_ptr<GraphElem> &node) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RW, true);
+    bool existed = doUpsertNode(externalId, node, tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return existed;
+}
+
+bool Database::doUpsertNode(const IndexKey &externalId, shared_ptr<GraphElem> &node, Transaction &tr) {
+    if(node->getType() != RT_NODE) {
+        throw IllegalArgumentException("Only nodes can have external IDs.");
+    }
+    if(node->getKey() != KEY_INVALID || node->getState() != GEState::DU) {
+        throw IllegalArgumentException("upsertNode needs a node never written before.");
+    }
+    if(tr.isReadonly()) {
+        throw TransactionException("Trying to write during a read-only transaction.");
+    }
+    ups_txn_t *upsTr = getUpsTrans(tr);
+    keyType existing;
+    if(!externalIds.lookup(externalId, existing, upsTr)) {
+        doWrite(node, tr);
+        externalIds.add(externalId, node->getKey(), upsTr);
+        return false;
+    }
+    auto foundElem = allLockedElems.find(existing);
+    if(foundElem != allLockedElems.end()) {
+        // an other transaction is refused here, ours would have two instances
+        checkKeyVsTrans(existing, tr);
+        throw IllegalArgumentException("The node of the external ID is already used in the transaction.");
+    }
+    // nobody holds the node, so its head can be read
+    uint8_t *head = findHead(existing, upsTr);
+    if(static_cast<RecordType>(head[FP_RECORDTYPE]) != RT_NODE ||
+            static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)) != node->pl()->getType()) {
+        throw IllegalArgumentException("The node of the external ID has an other payload type.");
+    }
+    // write it as a detached instance of the existing node, doWrite re-reads its chain
+    node->key = existing;
+    node->state = GEState::DK;
+    doWrite(node, tr);
+    return true;
+}
+
+void Database::lookupExternalIds(const deque<IndexKey> &ids, deque<keyType> &keys, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    ups_txn_t *upsTr = getUpsTrans(tr);
+    for(const IndexKey &id : ids) {
+        keyType key;
+        keys.push_back(externalIds.lookup(id, key, upsTr) ? key : static_cast<keyType>(KEY_INVALID));
+    }
+}
+
+void Database::lookupExternalIds(const deque<IndexKey> &ids, deque<keyType> &keys) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    ups_txn_t *upsTr = getUpsTrans(tr);
+    for(const IndexKey &id : ids) {
+        keyType key;
+        keys.push_back(externalIds.lookup(id, key, upsTr) ? key : static_cast<keyType>(KEY_INVALID));
+    }
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::getNodesByExternalIds(QueryResult &res, const deque<IndexKey> &ids, Filter &fltNode, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    ups_txn_t *upsTr = getUpsTrans(tr);
+    deque<keyType> found;
+    for(const IndexKey &id : ids) {
+        keyType key;
+        if(externalIds.lookup(id, key, upsTr)) {
+            found.push_back(key);
+        }
+    }
+    // reading in key order helps locality
+    sort(found.begin(), found.end());
+    found.erase(unique(found.begin(), found.end()), found.end());
+    keyType *keys = new keyType[found.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    doGetElemsByKeys(res, keys, fltNode, tr, omitFailed);
+}
+
+ups_txn_t* Database::getUpsTrans(Transaction &tr) {
+    transHandleType trHandle = tr.getHandle();
+    getCheckTransLocked(trHandle);
+    return upsTransactions.find(trHandle)->second;
+}
+
+size_t Database::countOfType(payloadType pt, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return types.count(pt, getUpsTrans(tr));
+}
+
+size_t Database::countOfType(payloadType pt) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    size_t count = types.count(pt, getUpsTrans(tr));
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return count;
+}
+
+void Database::countTypes(map<payloadType, size_t> &counts, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    counts.clear();
+    types.countAll(counts, getUpsTrans(tr));
+}
+
+void Database::countTypes(map<payloadType, size_t> &counts) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    counts.clear();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    types.countAll(counts, getUpsTrans(tr));
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::doGetElemsByKeys(QueryResult &queryResult, const keyType *keys, Filter &flt, Transaction &tr, bool omitFailed) {
+    transHandleType trHandle = tr.getHandle();
+    transLockedElemsMapType::iterator foundLockedElems = getCheckTransLocked(trHandle);
+    auto foundUpsTrans = upsTransactions.find(trHandle);
+    ups_txn_t *upsTr = foundUpsTrans->second;
+    const keyType *keyInd;
+    unordered_map<shared_ptr<GraphElem>, AfterCheck> checkResults;
+    // First gather graph elems and check them to allow possible exceptions be
+    // raised before we store the stuff in res
+    for(keyInd = keys; *keyInd != KEY_INVALID; keyInd++) {
+        lockedElemsMapType::iterator foundElem = allLockedElems.find(*keyInd);
+        shared_ptr<GraphElem> ge;
+        if(foundElem == allLockedElems.end()) {
+            // not found, we must read it from disk
+            try {
+                ge = doBareHead(*keyInd, upsTr);
+                checkACL(ge, tr);
+                if(flt.matchHead(ge->getHeadFields())) {
+                    checkResults[ge] = AfterCheck::JustRead;
+                }
+            }
+            catch(PermissionException &pe) {
+                if(!omitFailed) {
+                    throw;
+                }
+            }
+        }
+        else {
+            lockedElemsMapType::iterator foundInTr = foundLockedElems->second.find(*keyInd);
+            if(foundInTr != foundLockedElems->second.end()) {
+                // we own it, no more checks and registering
+                ge = foundInTr->second;
+                if(flt.matchHead(ge->getHeadFields())) {
+                    checkResults[ge] = AfterCheck::Ours;
+                }
+            }
+            else {
+                try {
+                    // somebody else owns it
+                    checkKeyVsTrans(*keyInd, tr);
+                    // now it is sure that this transaction is read-only and the one that
+                    // owns it is also read-only
+                    ge = foundElem->second;
+                    checkACL(ge, tr);
+                    if(flt.matchHead(ge->getHeadFields())) {
+                        checkResults[ge] = AfterCheck::Others;
+                    }
+                }
+                catch(PermissionException &pe) {
+                    if(!omitFailed) {
+                        throw;
+                    }
+                }
+                catch(TransactionException &te) {
+                    if(!omitFailed) {
+                        throw;
+                    }
+                }
+            }
+        }
+    }
+    // read the head filter survivors fully, UpscaleDB access is serialized anyway
+    deque<shared_ptr<GraphElem>> candidates;
+    for(auto &i : checkResults) {
+        i.first->read(upsTr, RCState::FULL);
+        candidates.push_back(i.first);
+    }
+    // deserializing makes sure the payload reflects the disc contents,
+    // then perform payload filtering
+    deque<uint8_t> matched(candidates.size(), 0);
+    deserializeAndMatch(candidates, matched, flt);
+    for(size_t i = 0; i < candidates.size(); i++) {
+        if(matched[i]) {
+            shared_ptr<GraphElem> &ge = candidates[i];
+            AfterCheck checkResult = checkResults[ge];
+            if(checkResult == AfterCheck::JustRead || checkResult == AfterCheck::Others) {
+                registerElem(ge, foundLockedElems, tr);
+            }
+            queryResult.insert(ge);
+        }
+    }
+}
+
+void Database::runParallel(size_t count, size_t chunk, const function<void(size_t, size_t)> &work) {
+    // a single chunk is processed here, the pool may be busy with an other job
+    if(count <= chunk) {
+        if(count > 0) {
+            work(0, count);
+        }
+        return;
+    }
+    atomic<size_t> next(0);
+    mutex errorMtx;
+    exception_ptr error;
+    auto worker = [&]() {
+        try {
+            size_t begin;
+            while((begin = next.fetch_add(chunk)) < count) {
+                work(begin, min(begin + chunk, count));
+            }
+        }
+        catch(...) {
+            lock_guard<mutex> lck(errorMtx);
+            if(!error) {
+                error = current_exception();
+            }
+            // let the others run out of work
+            next = count;
+        }
+    };
+    // the pool threads not needed find no chunk left
+    workerPool.run(worker);
+    if(error) {
+        rethrow_exception(error);
+    }
+}
+
+void Database::deserializeAndMatch(deque<shared_ptr<GraphElem>> &elems, deque<uint8_t> &matched, Filter &flt) {
+    // small chunks balance uneven payload sizes among the workers
+    runParallel(elems.size(), 8, [&elems, &matched, &flt](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            elems[i]->deserialize();
+            matched[i] = flt.match(elems[i]->pl()) ? 1 : 0;
+        }
+    });
+}
+
+void Database::buildCSR(CSRGraph &csr, bool withTypes) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    if(readWriteTransCount > 0) {
+        throw TransactionException("A CSR snapshot can be built only without open read-write transactions.");
+    }
+    csr.clear();
+    vector<keyType> edgeKeys, starts, ends;
+    vector<payloadType> edgeTypes;
+    vector<bool> edgeDirected;
+    // gather the fixed fields in one scan, UpscaleDB access is serialized anyway
+    ups_txn_t *upsTr;
+    check(ups_txn_begin(&upsTr, env, nullptr, nullptr, 0));
+    ups_cursor_t *cursor = nullptr;
+    try {
+        ups_key_t key;
+        ups_record_t rec;
+        memset(&key, 0, sizeof(key));
+        memset(&rec, 0, sizeof(rec));
+        check(ups_cursor_create(&cursor, db, upsTr, 0));
+        ups_status_t st = ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_FIRST);
+        while(st == UPS_SUCCESS) {
+            keyType headKey = *reinterpret_cast<keyType*>(key.data);
+            uint8_t *head = reinterpret_cast<uint8_t*>(rec.data);
+            RecordType rt = static_cast<RecordType>(head[FP_RECORDTYPE]);
+            if(rt == RT_NODE || rt == RT_ROOT) {
+                csr.nodeKeys.push_back(headKey);
+                if(withTypes) {
+                    csr.nodeTypes.push_back(rt == RT_ROOT ? static_cast<payloadType>(PT_ANY) : static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)));
+                }
+            }
+            else if(rt == RT_DEDGE || rt == RT_UEDGE) {
+                edgeKeys.push_back(headKey);
+                starts.push_back(FixedFieldIO::getField(FPE_NODE_START, head));
+                ends.push_back(FixedFieldIO::getField(FPE_NODE_END, head));
+                edgeDirected.push_back(rt == RT_DEDGE);
+                if(withTypes) {
+                    edgeTypes.push_back(static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)));
+                }
+            }
+            st = ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_NEXT);
+        }
+        if(st != UPS_KEY_NOT_FOUND) {
+            check(st);
+        }
+        check(ups_cursor_close(cursor));
+        cursor = nullptr;
+        check(ups_txn_commit(upsTr, 0));
+    }
+    catch(UpsException &e) {
+        if(cursor != nullptr) {
+            ups_cursor_close(cursor);
+        }
+        ups_txn_abort(upsTr, 0);
+        csr.clear();
+        throw;
+    }
+    // the keys come in ascending order from the cursor, so node indices are found by binary search
+    size_t edgeCount = edgeKeys.size();
+    vector<size_t> startIdx(edgeCount), endIdx(edgeCount);
+    runParallel(edgeCount, 4096, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            startIdx[i] = csr.findNode(starts[i]);
+            endIdx[i] = csr.findNode(ends[i]);
+        }
+    });
+    size_t nodeCount = csr.getNodeCount();
+    vector<size_t> counts(nodeCount + 1, 0);
+    for(size_t i = 0; i < edgeCount; i++) {
+        // edges with a missing end are left out
+        if(startIdx[i] < nodeCount && endIdx[i] < nodeCount) {
+            counts[startIdx[i]]++;
+            if(!edgeDirected[i]) {
+                counts[endIdx[i]]++;
+            }
+        }
+    }
+    csr.offsets.resize(nodeCount + 1);
+    size_t sum = 0;
+    for(size_t i = 0; i <= nodeCount; i++) {
+        csr.offsets[i] = sum;
+        sum += counts[i];
+    }
+    csr.targets.resize(sum);
+    csr.edgeKeys.resize(sum);
+    csr.directed.resize(sum);
+    if(withTypes) {
+        csr.edgeTypes.resize(sum);
+    }
+    vector<size_t> fill(csr.offsets.begin(), csr.offsets.end() - 1);
+    auto put = [&](size_t from, size_t to, size_t edge) {
+        size_t pos = fill[from]++;
+        csr.targets[pos] = to;
+        csr.edgeKeys[pos] = edgeKeys[edge];
+        csr.directed[pos] = edgeDirected[edge] ? 1 : 0;
+        if(withTypes) {
+            csr.edgeTypes[pos] = edgeTypes[edge];
+        }
+    };
+    for(size_t i = 0; i < edgeCount; i++) {
+        if(startIdx[i] < nodeCount && endIdx[i] < nodeCount) {
+            put(startIdx[i], endIdx[i], i);
+            if(!edgeDirected[i]) {
+                put(endIdx[i], startIdx[i], i);
+            }
+        }
+    }
+    // order each row by target, rows are independent
+    runParallel(nodeCount, 1024, [&](size_t begin, size_t end) {
+        vector<size_t> order;
+        vector<size_t> targets;
+        vector<keyType> keys;
+        vector<payloadType> types;
+        vector<uint8_t> dirs;
+        for(size_t node = begin; node < end; node++) {
+            size_t first = csr.offsets[node];
+            size_t length = csr.offsets[node + 1] - first;
+            if(length < 2) {
+                continue;
+            }
+            order.resize(length);
+            for(size_t i = 0; i < length; i++) {
+                order[i] = first + i;
+            }
+            sort(order.begin(), order.end(), [&csr](size_t a, size_t b) {
+                return csr.targets[a] < csr.targets[b] || (csr.targets[a] == csr.targets[b] && csr.edgeKeys[a] < csr.edgeKeys[b]);
+            });
+            targets.clear();
+            keys.clear();
+            types.clear();
+            dirs.clear();
+            for(size_t pos : order) {
+                targets.push_back(csr.targets[pos]);
+                keys.push_back(csr.edgeKeys[pos]);
+                dirs.push_back(csr.directed[pos]);
+                if(withTypes) {
+                    types.push_back(csr.edgeTypes[pos]);
+                }
+            }
+            copy(targets.begin(), targets.end(), csr.targets.begin() + first);
+            copy(keys.begin(), keys.end(), csr.edgeKeys.begin() + first);
+            copy(dirs.begin(), dirs.end(), csr.directed.begin() + first);
+            if(withTypes) {
+                copy(types.begin(), types.end(), csr.edgeTypes.begin() + first);
+            }
+        }
+    });
+}
+
+void Database::pageRank(const CSRGraph &csr, vector<double> &ranks, double damping, size_t maxIterations, double tolerance) {
+    size_t nodeCount = csr.getNodeCount();
+    ranks.assign(nodeCount, nodeCount == 0 ? 0.0 : 1.0 / nodeCount);
+    if(nodeCount == 0) {
+        return;
+    }
+    // the incoming links are needed to let each thread compute its own nodes
+    vector<size_t> inOffsets(nodeCount + 1, 0);
+    for(size_t target : csr.targets) {
+        inOffsets[target + 1]++;
+    }
+    for(size_t i = 0; i < nodeCount; i++) {
+        inOffsets[i + 1] += inOffsets[i];
+    }
+    vector<size_t> sources(csr.targets.size());
+    vector<size_t> fill(inOffsets.begin(), inOffsets.end() - 1);
+    for(size_t node = 0; node < nodeCount; node++) {
+        for(size_t pos = csr.offsets[node]; pos < csr.offsets[node + 1]; pos++) {
+            sources[fill[csr.targets[pos]]++] = node;
+        }
+    }
+    vector<double> next(nodeCount);
+    vector<double> share(nodeCount);
+    for(size_t iteration = 0; iteration < maxIterations; iteration++) {
+        double dangling = 0.0;
+        for(size_t node = 0; node < nodeCount; node++) {
+            size_t outDegree = csr.offsets[node + 1] - csr.offsets[node];
+            if(outDegree == 0) {
+                dangling += ranks[node];
+                share[node] = 0.0;
+            }
+            else {
+                share[node] = ranks[node] / outDegree;
+            }
+        }
+        double base = (1.0 - damping + damping * dangling) / nodeCount;
+        runParallel(nodeCount, 1024, [&](size_t begin, size_t end) {
+            for(size_t node = begin; node < end; node++) {
+                double sum = 0.0;
+                for(size_t pos = inOffsets[node]; pos < inOffsets[node + 1]; pos++) {
+                    sum += share[sources[pos]];
+                }
+                next[node] = base + damping * sum;
+            }
+        });
+        double change = 0.0;
+        for(size_t node = 0; node < nodeCount; node++) {
+            change += fabs(next[node] - ranks[node]);
+        }
+        ranks.swap(next);
+        if(change < tolerance) {
+            break;
+        }
+    }
+}
+
+void Database::connectedComponents(const CSRGraph &csr, vector<size_t> &components) {
+    size_t nodeCount = csr.getNodeCount();
+    unique_ptr<atomic<size_t>[]> labels(new atomic<size_t>[nodeCount]);
+    for(size_t i = 0; i < nodeCount; i++) {
+        labels[i].store(i, memory_order_relaxed);
+    }
+    // lowers the label at node to value, returns true if changed
+    auto lower = [&labels](size_t node, size_t value) {
+        size_t actual = labels[node].load(memory_order_relaxed);
+        while(value < actual) {
+            if(labels[node].compare_exchange_weak(actual, value, memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    // propagate the minimal label along both ends of each link until stable
+    atomic<bool> changed(true);
+    while(changed.load()) {
+        changed = false;
+        runParallel(nodeCount, 1024, [&](size_t begin, size_t end) {
+            bool local = false;
+            for(size_t node = begin; node < end; node++) {
+                for(size_t pos = csr.offsets[node]; pos < csr.offsets[node + 1]; pos++) {
+                    size_t other = csr.targets[pos];
+                    size_t mine = labels[node].load(memory_order_relaxed);
+                    size_t theirs = labels[other].load(memory_order_relaxed);
+                    if(mine < theirs) {
+                        local |= lower(other, mine);
+                    }
+                    else if(theirs < mine) {
+                        local |= lower(node, theirs);
+                    }
+                }
+            }
+            if(local) {
+                changed = true;
+            }
+        });
+    }
+    components.resize(nodeCount);
+    for(size_t i = 0; i < nodeCount; i++) {
+        components[i] = labels[i].load(memory_order_relaxed);
+    }
+}
+
+void Database::degreeCentrality(const CSRGraph &csr, vector<double> &centrality, EdgeEndType direction) {
+    size_t nodeCount = csr.getNodeCount();
+    vector<size_t> degrees(nodeCount, 0);
+    if(direction == EdgeEndType::In || direction == EdgeEndType::Any) {
+        // directed edges are counted at their end, undirected ones are in both rows anyway
+        for(size_t pos = 0; pos < csr.targets.size(); pos++) {
+            if(csr.directed[pos]) {
+                degrees[csr.targets[pos]]++;
+            }
+        }
+    }
+    runParallel(nodeCount, 1024, [&](size_t begin, size_t end) {
+        for(size_t node = begin; node < end; node++) {
+            for(size_t pos = csr.offsets[node]; pos < csr.offsets[node + 1]; pos++) {
+                if(csr.directed[pos] ? (direction == EdgeEndType::Out || direction == EdgeEndType::Any) :
+                        (direction == EdgeEndType::Un || direction == EdgeEndType::Any)) {
+                    degrees[node]++;
+                }
+            }
+        }
+    });
+    centrality.resize(nodeCount);
+    double divisor = nodeCount > 1 ? static_cast<double>(nodeCount - 1) : 1.0;
+    for(size_t i = 0; i < nodeCount; i++) {
+        centrality[i] = degrees[i] / divisor;
+    }
+}
+
+size_t Database::writeScores(const CSRGraph &csr, const vector<double> &values, ScoreSetter &setter, size_t batchSize, size_t *committed) {
+    if(committed != nullptr) {
+        *committed = 0;
+    }
+    if(values.size() != csr.getNodeCount()) {
+        throw IllegalArgumentException("Score count does not match node count.");
+    }
+    if(batchSize == 0) {
+        batchSize = 1;
+    }
+    size_t written = 0;
+    for(size_t begin = 0; begin < values.size(); begin += batchSize) {
+        lock_guard<mutex> lck(accessMtx);
+        isReady();
+        Transaction tr = doBeginTrans(TT::RW, true);
+        deque<shared_ptr<GraphElem>> changed;
+        for(size_t i = begin; i < min(begin + batchSize, values.size()); i++) {
+            if(csr.nodeKeys[i] == KEY_ROOT) {
+                continue;
+            }
+            shared_ptr<GraphElem> node = doRead(csr.nodeKeys[i], tr, RCState::FULL);
+            if(setter.set(node->pl(), values[i])) {
+                changed.push_back(node);
+            }
+        }
+        doWrite(changed, tr);
+        doEndTrans(tr, TransactionEnd::COMMIT);
+        written += changed.size();
+        if(committed != nullptr) {
+            *committed = min(begin + batchSize, values.size());
+        }
+    }
+    return written;
+}
+
+void Database::findOrphans(OrphanReport &report, bool remove) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    report.clear();
+    if(remove && upsTransactions.size() > 0) {
+        throw TransactionException("Orphans can be removed only without open transactions.");
+    }
+    if(readWriteTransCount > 0) {
+        throw TransactionException("Orphans can be searched only without open read-write transactions.");
+    }
+    vector<keyType> nodeKeys, nodeNext, edgeKeys, edgeStart, edgeEnd, edgeNext, contKeys, contNext, otherNext;
+    vector<uint8_t> edgeRT;
+    vector<payloadType> nodeTypes, edgeTypes;
+    ups_txn_t *upsTr;
+    check(ups_txn_begin(&upsTr, env, nullptr, nullptr, 0));
+    ups_cursor_t *cursor = nullptr;
+    try {
+        ups_key_t key;
+        ups_record_t rec;
+        memset(&key, 0, sizeof(key));
+        memset(&rec, 0, sizeof(rec));
+        check(ups_cursor_create(&cursor, db, upsTr, 0));
+        ups_status_t st = ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_FIRST);
+        while(st == UPS_SUCCESS) {
+            keyType recKey = *reinterpret_cast<keyType*>(key.data);
+            uint8_t *head = reinterpret_cast<uint8_t*>(rec.data);
+            RecordType rt = static_cast<RecordType>(head[FP_RECORDTYPE]);
+            keyType next = FixedFieldIO::getField(FP_NEXT, head);
+            if(rt == RT_NODE || rt == RT_ROOT) {
+                nodeKeys.push_back(recKey);
+                nodeNext.push_back(next);
+                nodeTypes.push_back(static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)));
+            }
+            else if(rt == RT_DEDGE || rt == RT_UEDGE) {
+                edgeKeys.push_back(recKey);
+                edgeStart.push_back(FixedFieldIO::getField(FPE_NODE_START, head));
+                edgeEnd.push_back(FixedFieldIO::getField(FPE_NODE_END, head));
+                edgeNext.push_back(next);
+                edgeRT.push_back(static_cast<uint8_t>(rt));
+                edgeTypes.push_back(static_cast<payloadType>(FixedFieldIO::getField(FP_PAYLOADTYPE, head)));
+            }
+            else if(rt == RT_CONT) {
+                contKeys.push_back(recKey);
+                contNext.push_back(next);
+            }
+            else {
+                otherNext.push_back(next);
+            }
+            st = ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_NEXT);
+        }
+        if(st != UPS_KEY_NOT_FOUND) {
+            check(st);
+        }
+        check(ups_cursor_close(cursor));
+        cursor = nullptr;
+        check(ups_txn_commit(upsTr, 0));
+    }
+    catch(...) {
+        if(cursor != nullptr) {
+            ups_cursor_close(cursor);
+        }
+        ups_txn_abort(upsTr, 0);
+        throw;
+    }
+    // the cursor returns the keys in ascending order
+    auto indexOf = [](const vector<keyType> &keys, keyType key) {
+        auto found = lower_bound(keys.begin(), keys.end(), key);
+        return found != keys.end() && *found == key ? static_cast<size_t>(found - keys.begin()) : keys.size();
+    };
+    size_t nodeCount = nodeKeys.size();
+    size_t edgeCount = edgeKeys.size();
+    vector<size_t> startIdx(edgeCount), endIdx(edgeCount);
+    runParallel(edgeCount, 4096, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            startIdx[i] = indexOf(nodeKeys, edgeStart[i]);
+            endIdx[i] = indexOf(nodeKeys, edgeEnd[i]);
+        }
+    });
+    // adjacency ignoring directions
+    vector<size_t> offsets(nodeCount + 1, 0);
+    for(size_t i = 0; i < edgeCount; i++) {
+        if(startIdx[i] < nodeCount && endIdx[i] < nodeCount) {
+            offsets[startIdx[i] + 1]++;
+            offsets[endIdx[i] + 1]++;
+        }
+    }
+    for(size_t i = 0; i < nodeCount; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    vector<size_t> neighbours(offsets[nodeCount]);
+    vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < edgeCount; i++) {
+        if(startIdx[i] < nodeCount && endIdx[i] < nodeCount) {
+            neighbours[fill[startIdx[i]]++] = endIdx[i];
+            neighbours[fill[endIdx[i]]++] = startIdx[i];
+        }
+    }
+    // mark phase, each node enters the frontier once thanks to the atomic bitmap
+    const size_t bits = 64;
+    unique_ptr<atomic<uint64_t>[]> marked(new atomic<uint64_t>[nodeCount / bits + 1]);
+    for(size_t i = 0; i <= nodeCount / bits; i++) {
+        marked[i].store(0, memory_order_relaxed);
+    }
+    auto mark = [&marked, bits](size_t node) {
+        uint64_t mask = static_cast<uint64_t>(1) << (node % bits);
+        return (marked[node / bits].fetch_or(mask, memory_order_relaxed) & mask) == 0;
+    };
+    auto isMarked = [&marked, bits](size_t node) {
+        return (marked[node / bits].load(memory_order_relaxed) & (static_cast<uint64_t>(1) << (node % bits))) != 0;
+    };
+    vector<size_t> frontier;
+    size_t rootIdx = indexOf(nodeKeys, KEY_ROOT);
+    if(rootIdx < nodeCount) {
+        mark(rootIdx);
+        frontier.push_back(rootIdx);
+    }
+    while(frontier.size() > 0) {
+        vector<size_t> next;
+        mutex nextMtx;
+        runParallel(frontier.size(), 256, [&](size_t begin, size_t end) {
+            vector<size_t> local;
+            for(size_t i = begin; i < end; i++) {
+                size_t node = frontier[i];
+                for(size_t pos = offsets[node]; pos < offsets[node + 1]; pos++) {
+                    if(mark(neighbours[pos])) {
+                        local.push_back(neighbours[pos]);
+                    }
+                }
+            }
+            lock_guard<mutex> lck(nextMtx);
+            next.insert(next.end(), local.begin(), local.end());
+        });
+        frontier.swap(next);
+    }
+    vector<keyType> chainStarts(otherNext);
+    for(size_t i = 0; i < nodeCount; i++) {
+        if(isMarked(i)) {
+            chainStarts.push_back(nodeNext[i]);
+        }
+        else {
+            report.nodes.push_back(nodeKeys[i]);
+        }
+    }
+    for(size_t i = 0; i < edgeCount; i++) {
+        if((startIdx[i] < nodeCount && isMarked(startIdx[i])) || (endIdx[i] < nodeCount && isMarked(endIdx[i]))) {
+            chainStarts.push_back(edgeNext[i]);
+        }
+        else {
+            report.edges.push_back(edgeKeys[i]);
+        }
+    }
+    // sweep the continuation records following the chains of the kept records
+    vector<uint8_t> owned(contKeys.size(), 0);
+    for(keyType next : chainStarts) {
+        size_t idx;
+        while(next != KEY_INVALID && (idx = indexOf(contKeys, next)) < contKeys.size() && !owned[idx]) {
+            owned[idx] = 1;
+            next = contNext[idx];
+        }
+    }
+    // records in the chains of orphans are erased with them, so they are not reported
+    deque<keyType> toErase;
+    // the chain of the ith orphan, edges first, ends before toErase[chainEnds[i]]
+    vector<size_t> chainEnds;
+    auto eraseChain = [&](keyType head, keyType next) {
+        toErase.push_back(head);
+        size_t idx;
+        while(next != KEY_INVALID && (idx = indexOf(contKeys, next)) < contKeys.size() && !owned[idx]) {
+            owned[idx] = 1;
+            toErase.push_back(next);
+            next = contNext[idx];
+        }
+        chainEnds.push_back(toErase.size());
+    };
+    for(keyType edge : report.edges) {
+        eraseChain(edge, edgeNext[indexOf(edgeKeys, edge)]);
+    }
+    for(keyType node : report.nodes) {
+        eraseChain(node, nodeNext[indexOf(nodeKeys, node)]);
+    }
+    for(size_t i = 0; i < contKeys.size(); i++) {
+        if(!owned[i]) {
+            report.strayRecords.push_back(contKeys[i]);
+            toErase.push_back(contKeys[i]);
+        }
+    }
+    if(!remove) {
+        return;
+    }
+    // erase in batches to keep the transactions small, but all index entries and
+    // records of an elem in the same one, so a failure leaves no elem half erased
+    const size_t batchSize = 10000;
+    size_t inBatch = 0;
+    size_t erased = 0;
+    check(ups_txn_begin(&upsTr, env, nullptr, nullptr, 0));
+    try {
+        auto eraseRecords = [&](size_t end) {
+            for(; erased < end; erased++, inBatch++) {
+                ups_key_t key;
+                memset(&key, 0, sizeof(key));
+                key.data = &toErase[erased];
+                key.size = sizeof(keyType);
+                ups_status_t st = _ups_db_erase(db, upsTr, &key, 0);
+                if(st != UPS_KEY_NOT_FOUND) {
+                    check(st);
+                }
+            }
+            if(inBatch >= batchSize) {
+                check(ups_txn_commit(upsTr, 0));
+                upsTr = nullptr;
+                check(ups_txn_begin(&upsTr, env, nullptr, nullptr, 0));
+                inBatch = 0;
+            }
+        };
+        size_t elem = 0;
+        for(keyType edge : report.edges) {
+            size_t i = indexOf(edgeKeys, edge);
+            RecordType rt = static_cast<RecordType>(edgeRT[i]);
+            edgeEnds.remove(edge, rt, edgeStart[i], edgeEnd[i], upsTr);
+            adjacency.remove(edge, rt, edgeTypes[i], edgeStart[i], edgeEnd[i], upsTr);
+            types.remove(edgeTypes[i], edge, upsTr);
+            removeFromPayloadIndexes(edge, upsTr);
+            eraseRecords(chainEnds[elem++]);
+        }
+        for(keyType node : report.nodes) {
+            types.remove(nodeTypes[indexOf(nodeKeys, node)], node, upsTr);
+            externalIds.remove(node, upsTr);
+            removeFromPayloadIndexes(node, upsTr);
+            eraseRecords(chainEnds[elem++]);
+        }
+        while(erased < toErase.size()) {
+            eraseRecords(erased + 1);
+        }
+        check(ups_txn_commit(upsTr, 0));
+    }
+    catch(...) {
+        if(upsTr != nullptr) {
+            ups_txn_abort(upsTr, 0);
+        }
+        throw;
+    }
+    report.removed = true;
+}
+
+void Database::setWorkerThreads(unsigned n) {
+    lock_guard<mutex> lck(accessMtx);
+    if(n == 0) {
+        n = thread::hardware_concurrency();
+    }
+    // waits for the running job, and goes on with the threads the system could start
+    workerPool.resize(n <= 1 ? 0 : n - 1);
+}
+
+void Database::getEdgesBetween(QueryResult &res, shared_ptr<GraphElem> &ge, shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    const keyType *edgeKeys = doGetEdgeKeysBetween(ge->getKey(), other->getKey(), direction, tr);
+    AutoDeleter<keyType> deleteKeys(edgeKeys);
+    doGetElemsByKeys(res, edgeKeys, fltEdge, tr, omitFailed);
+}
+
+void Database::getEdgesBetween(QueryResult &res, shared_ptr<GraphElem> &ge, shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    const keyType *edgeKeys = doGetEdgeKeysBetween(ge->getKey(), other->getKey(), direction, tr);
+    AutoDeleter<keyType> deleteKeys(edgeKeys);
+    doGetElemsByKeys(res, edgeKeys, fltEdge, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+bool Database::existsEdge(shared_ptr<GraphElem> &ge, shared_ptr<GraphElem> &other, EdgeEndType direction, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    checkUnregisteredRead(ge->getKey(), tr);
+    checkUnregisteredRead(other->getKey(), tr);
+    const keyType *edgeKeys = doGetEdgeKeysBetween(ge->getKey(), other->getKey(), direction, tr, true);
+    AutoDeleter<keyType> deleteKeys(edgeKeys);
+    return *edgeKeys != KEY_INVALID;
+}
+
+bool Database::existsEdge(shared_ptr<GraphElem> &ge, shared_ptr<GraphElem> &other, EdgeEndType direction) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    checkUnregisteredRead(ge->getKey(), tr);
+    checkUnregisteredRead(other->getKey(), tr);
+    const keyType *edgeKeys = doGetEdgeKeysBetween(ge->getKey(), other->getKey(), direction, tr, true);
+    AutoDeleter<keyType> deleteKeys(edgeKeys);
+    bool ret = *edgeKeys != KEY_INVALID;
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+bool Database::existsEdgeOfType(shared_ptr<GraphElem> &ge, EdgeEndType direction, payloadType pt, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doExistsEdgeOfType(ge->getKey(), direction, pt, tr);
+}
+
+bool Database::existsEdgeOfType(shared_ptr<GraphElem> &ge, EdgeEndType direction, payloadType pt) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    bool ret = doExistsEdgeOfType(ge->getKey(), direction, pt, tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+bool Database::doExistsEdgeOfType(keyType node, EdgeEndType direction, payloadType pt, Transaction &tr) {
+    if(node == KEY_INVALID) {
+        throw IllegalArgumentException("The node must have valid key.");
+    }
+    checkUnregisteredRead(node, tr);
+    ups_txn_t *upsTr = getUpsTrans(tr);
+    return ((direction == EdgeEndType::In || direction == EdgeEndType::Any) && adjacency.exists(node, FPN_IN_BUCKETS, pt, upsTr)) ||
+        ((direction == EdgeEndType::Out || direction == EdgeEndType::Any) && adjacency.exists(node, FPN_OUT_BUCKETS, pt, upsTr)) ||
+        ((direction == EdgeEndType::Un || direction == EdgeEndType::Any) && adjacency.exists(node, FPN_UN_BUCKETS, pt, upsTr));
+}
+
+size_t Database::countEdges(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doCountEdges(ge->getKey(), direction, fltEdge, tr, numeric_limits<size_t>::max(), omitFailed);
+}
+
+size_t Database::countEdges(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    size_t ret = doCountEdges(ge->getKey(), direction, fltEdge, tr, numeric_limits<size_t>::max(), omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+bool Database::anyEdge(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doCountEdges(ge->getKey(), direction, fltEdge, tr, 1, omitFailed) > 0;
+}
+
+bool Database::anyEdge(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    bool ret = doCountEdges(ge->getKey(), direction, fltEdge, tr, 1, omitFailed) > 0;
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+size_t Database::doCountEdges(keyType node, EdgeEndType direction, Filter &fltEdge, Transaction &tr, size_t max, bool omitFailed) {
+    if(node == KEY_INVALID) {
+        throw IllegalArgumentException("The node must have valid key.");
+    }
+    checkUnregisteredRead(node, tr);
+    transHandleType trHandle = tr.getHandle();
+    transLockedElemsMapType::iterator foundLockedElems = getCheckTransLocked(trHandle);
+    ups_txn_t *upsTr = upsTransactions.find(trHandle)->second;
+    bool byType = fltEdge.matchesByTypeOnly();
+    size_t count = 0;
+    auto visit = [&](keyType edge) {
+        try {
+            if(byType) {
+                // the index entry has the right type, only the lock and the ACL remain
+                checkUnregisteredRead(edge, tr);
+                count++;
+            }
+            else {
+                if(allLockedElems.find(edge) != allLockedElems.end() &&
+                        foundLockedElems->second.find(edge) == foundLockedElems->second.end()) {
+                    // somebody else owns it
+                    checkKeyVsTrans(edge, tr);
+                }
+                // the changes of our own transaction are already saved, so a private
+                // instance read from disk is up-to-date
+                shared_ptr<GraphElem> ge = doBareHead(edge, upsTr);
+                checkACL(ge, tr);
+                if(fltEdge.matchHead(ge->getHeadFields())) {
+                    ge->read(upsTr, RCState::FULL);
+                    ge->deserialize();
+                    if(fltEdge.match(ge->pl())) {
+                        count++;
+                    }
+                }
+            }
+        }
+        catch(PermissionException &pe) {
+            if(!omitFailed) {
+                throw;
+            }
+        }
+        catch(TransactionException &te) {
+            if(!omitFailed) {
+                throw;
+            }
+        }
+        return count < max;
+    };
+    payloadType pt = fltEdge.getPayloadType();
+    if(direction == EdgeEndType::In || direction == EdgeEndType::Any) {
+        if(!adjacency.forEach(node, FPN_IN_BUCKETS, pt, visit, upsTr)) {
+            return count;
+        }
+    }
+    if(direction == EdgeEndType::Out || direction == EdgeEndType::Any) {
+        if(!adjacency.forEach(node, FPN_OUT_BUCKETS, pt, visit, upsTr)) {
+            return count;
+        }
+    }
+    if(direction == EdgeEndType::Un || direction == EdgeEndType::Any) {
+        adjacency.forEach(node, FPN_UN_BUCKETS, pt, visit, upsTr);
+    }
+    return count;
+}
+
+EdgeAggregate Database::getAggregate(shared_ptr<GraphElem> &ge, uint16_t indexId, EdgeEndType direction, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    AggregateIndex &aggregateIndex = getAggregateIndex(indexId);
+    checkUnregisteredRead(ge->getKey(), tr);
+    return aggregateIndex.get(ge->getKey(), endBits(direction), getUpsTrans(tr));
+}
+
+EdgeAggregate Database::getAggregate(shared_ptr<GraphElem> &ge, uint16_t indexId, EdgeEndType direction) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    AggregateIndex &aggregateIndex = getAggregateIndex(indexId);
+    Transaction tr = doBeginTrans(TT::RO, true);
+    checkUnregisteredRead(ge->getKey(), tr);
+    EdgeAggregate ret = aggregateIndex.get(ge->getKey(), endBits(direction), getUpsTrans(tr));
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+AggregateIndex& Database::getAggregateIndex(uint16_t indexId) {
+    if(indexId >= aggregateIndexes.size()) {
+        throw DatabaseException((string("Unknown aggregate index: ") + to_string(indexId)).c_str());
+    }
+    return *aggregateIndexes[indexId];
+}
+
+uint8_t Database::endBits(EdgeEndType direction) {
+    switch(direction) {
+    case EdgeEndType::In:
+        return EEB_IN;
+    case EdgeEndType::Out:
+        return EEB_OUT;
+    case EdgeEndType::Un:
+        return EEB_UN;
+    default:
+        return EEB_ANY;
+    }
+}
+
+keyType* Database::doGetEdgeKeysBetween(keyType from, keyType to, EdgeEndType direction, Transaction &tr, bool onlyFirst) {
+    if(from == KEY_INVALID || to == KEY_INVALID) {
+        throw IllegalArgumentException("Both nodes must have valid key.");
+    }
+    transHandleType trHandle = tr.getHandle();
+    // only to check the transaction
+    getCheckTransLocked(trHandle);
+    ups_txn_t *upsTr = upsTransactions.find(trHandle)->second;
+    deque<keyType> found;
+    switch(direction) {
+    case EdgeEndType::Any:
+        // undirected edges are found in both orientations, take them only once
+        if((edgeEnds.collect(from, to, RT_INVALID, found, upsTr, onlyFirst) == 0 || !onlyFirst) && from != to) {
+            edgeEnds.collect(to, from, RT_DEDGE, found, upsTr, onlyFirst);
+        }
+        break;
+    case EdgeEndType::In:
+        edgeEnds.collect(to, from, RT_DEDGE, found, upsTr, onlyFirst);
+        break;
+    case EdgeEndType::Out:
+        edgeEnds.collect(from, to, RT_DEDGE, found, upsTr, onlyFirst);
+        break;
+    case EdgeEndType::Un:
+        edgeEnds.collect(from, to, RT_UEDGE, found, upsTr, onlyFirst);
+        break;
+    }
+    keyType *keys = new keyType[found.size() + 1];
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    return keys;
+}
+
+keyType* Database::doGetEdgeKeysOfType(keyType node, EdgeEndType direction, payloadType pt, Transaction &tr) {
+    deque<keyType> found;
+    collectAdjacent(node, direction, pt, found, nullptr, upsTransactions.find(tr.getHandle())->second);
+    keyType *keys = new keyType[found.size() + 1];
+    copy(found.begin(), found.end(), keys);
+    keys[found.size()] = KEY_INVALID;
+    return keys;
+}
+
+void Database::collectAdjacent(keyType node, EdgeEndType direction, payloadType pt, deque<keyType> &edges, deque<keyType> *others, ups_txn_t *upsTr) {
+    if(direction == EdgeEndType::In || direction == EdgeEndType::Any) {
+        adjacency.collect(node, FPN_IN_BUCKETS, pt, edges, upsTr, others);
+    }
+    if(direction == EdgeEndType::Out || direction == EdgeEndType::Any) {
+        adjacency.collect(node, FPN_OUT_BUCKETS, pt, edges, upsTr, others);
+    }
+    if(direction == EdgeEndType::Un || direction == EdgeEndType::Any) {
+        adjacency.collect(node, FPN_UN_BUCKETS, pt, edges, upsTr, others);
+    }
+}
+
+void Database::doGetNeighbours(QueryResult &res, shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Filter &fltNode, Transaction &tr, bool omitFailed) {
+    deque<keyType> nodeKeys;
+    collectNeighbourKeys(ge, direction, fltEdge, nodeKeys, tr, omitFailed);
+    loadNeighbours(res, nodeKeys, fltNode, tr, omitFailed);
+}
+
+void Database::collectNeighbourKeys(shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, deque<keyType> &nodeKeys, Transaction &tr, bool omitFailed) {
+    // make sure the originating graph elem is a member of the transaction
+    doAttach(ge, tr, AM::KEEP_PL);
+    keyType origin = ge->getKey();
+    if(fltEdge.matchesByTypeOnly()) {
+        // the edges need not be read, the adjacency index holds the other ends
+        deque<keyType> edgeKeys;
+        collectAdjacent(origin, direction, fltEdge.getPayloadType(), edgeKeys, &nodeKeys, upsTransactions.find(tr.getHandle())->second);
+    }
+    else {
+        QueryResult edges;
+        doGetEdges(edges, ge, direction, fltEdge, tr, omitFailed);
+        // the edges are already read, take their ends from the record chains
+        for(auto &edge : edges) {
+            keyType start = edge->chainNew.getHeadField(FPE_NODE_START);
+            nodeKeys.push_back(start == origin ? edge->chainNew.getHeadField(FPE_NODE_END) : start);
+        }
+    }
+}
+
+void Database::loadNeighbours(QueryResult &res, deque<keyType> &nodeKeys, Filter &fltNode, Transaction &tr, bool omitFailed, const unordered_set<keyType> *exclude) {
+    // parallel edges lead to the same node, and reading in key order helps locality
+    sort(nodeKeys.begin(), nodeKeys.end());
+    nodeKeys.erase(unique(nodeKeys.begin(), nodeKeys.end()), nodeKeys.end());
+    nodeKeys.erase(remove_if(nodeKeys.begin(), nodeKeys.end(), [exclude](keyType key) {
+        return key == KEY_ROOT || (exclude != nullptr && exclude->count(key) > 0);
+    }), nodeKeys.end());
+    keyType *keys = new keyType[nodeKeys.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(nodeKeys.begin(), nodeKeys.end(), keys);
+    keys[nodeKeys.size()] = KEY_INVALID;
+    doGetElemsByKeys(res, keys, fltNode, tr, omitFailed);
+}
+
+countType Database::getDegree(shared_ptr<GraphElem> &ge, EdgeEndType direction, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doGetDegree(ge->getKey(), direction, tr);
+}
+
+countType Database::getDegree(shared_ptr<GraphElem> &ge, EdgeEndType direction) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    countType ret = doGetDegree(ge->getKey(), direction, tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+deque<countType> Database::getDegrees(const deque<shared_ptr<GraphElem>> &nodes, EdgeEndType direction, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doGetDegrees(nodes, direction, tr);
+}
+
+deque<countType> Database::getDegrees(const deque<shared_ptr<GraphElem>> &nodes, EdgeEndType direction) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    deque<countType> ret = doGetDegrees(nodes, direction, tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+deque<countType> Database::doGetDegrees(const deque<shared_ptr<GraphElem>> &nodes, EdgeEndType direction, Transaction &tr) {
+    for(auto &node : nodes) {
+        node->assureNode();
+    }
+    // visit the keys in ascending order to read neighbouring B-tree pages together
+    vector<size_t> order(nodes.size());
+    for(size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&nodes](size_t a, size_t b) {
+        return nodes[a]->getKey() < nodes[b]->getKey();
+    });
+    deque<countType> ret(nodes.size());
+    for(size_t i : order) {
+        ret[i] = doGetDegree(nodes[i]->getKey(), direction, tr);
+    }
+    return ret;
+}
+
+countType Database::doGetDegree(keyType key, EdgeEndType direction, Transaction &tr) {
+    uint8_t *head = checkUnregisteredRead(key, tr);
+    RecordType recType = static_cast<RecordType>(FixedFieldIO::getField(FP_RECORDTYPE, head));
+    if(recType != RT_NODE && recType != RT_ROOT) {
+        throw IllegalMethodException("Degree may only be queried for a Node.");
+    }
+    countType ret = 0;
+    if(direction == EdgeEndType::In || direction == EdgeEndType::Any) {
+        ret += FixedFieldIO::getField(FPN_IN_USED, head);
+    }
+    if(direction == EdgeEndType::Out || direction == EdgeEndType::Any) {
+        ret += FixedFieldIO::getField(FPN_OUT_USED, head);
+    }
+    if(direction == EdgeEndType::Un || direction == EdgeEndType::Any) {
+        ret += FixedFieldIO::getField(FPN_UN_USED, head);
+    }
+    return ret;
+}
+
+void Database::traverseFromRoot(deque<QueryResult> &levels, const deque<Hop> &hops, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    shared_ptr<GraphElem> root = doRead(KEY_ROOT, tr, RCState::FULL);
+    doTraverse(root, levels, hops, tr, omitFailed);
+}
+
+void Database::traverseFromRoot(deque<QueryResult> &levels, const deque<Hop> &hops, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    shared_ptr<GraphElem> root = doRead(KEY_ROOT, tr, RCState::FULL);
+    doTraverse(root, levels, hops, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::traverse(shared_ptr<GraphElem> &start, deque<QueryResult> &levels, const deque<Hop> &hops, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    doTraverse(start, levels, hops, tr, omitFailed);
+}
+
+void Database::traverse(shared_ptr<GraphElem> &start, deque<QueryResult> &levels, const deque<Hop> &hops, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    doTraverse(start, levels, hops, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::doTraverse(shared_ptr<GraphElem> &start, deque<QueryResult> &levels, const deque<Hop> &hops, Transaction &tr, bool omitFailed) {
+    unordered_set<keyType> visited;
+    visited.insert(start->getKey());
+    deque<shared_ptr<GraphElem>> frontier;
+    frontier.push_back(start);
+    for(const Hop &hop : hops) {
+        deque<keyType> nodeKeys;
+        for(auto &node : frontier) {
+            collectNeighbourKeys(node, hop.direction, hop.fltEdge, nodeKeys, tr, omitFailed);
+        }
+        QueryResult level;
+        loadNeighbours(level, nodeKeys, hop.fltNode, tr, omitFailed, &visited);
+        if(level.size() == 0) {
+            break;
+        }
+        frontier.clear();
+        for(auto &node : level) {
+            visited.insert(node->getKey());
+            frontier.push_back(node);
+        }
+        levels.push_back(move(level));
+    }
+}
+
+void Database::expandNodes(const deque<keyType> &nodes, EdgeEndType direction, Filter &fltEdge, deque<keyType> &from, deque<keyType> &edges, deque<keyType> &others, unordered_map<keyType, shared_ptr<GraphElem>> *read, Transaction &tr, bool omitFailed) {
+    ups_txn_t *upsTr = upsTransactions.find(tr.getHandle())->second;
+    deque<keyType> foundEdges, foundOthers;
+    for(keyType node : nodes) {
+        size_t before = foundEdges.size();
+        collectAdjacent(node, direction, fltEdge.getPayloadType(), foundEdges, &foundOthers, upsTr);
+        from.insert(from.end(), foundEdges.size() - before, node);
+    }
+    if(read == nullptr && fltEdge.matchesByTypeOnly()) {
+        edges.insert(edges.end(), foundEdges.begin(), foundEdges.end());
+        others.insert(others.end(), foundOthers.begin(), foundOthers.end());
+        return;
+    }
+    // read all the edges of the batch at once
+    deque<keyType> sortedEdges(foundEdges);
+    sort(sortedEdges.begin(), sortedEdges.end());
+    sortedEdges.erase(unique(sortedEdges.begin(), sortedEdges.end()), sortedEdges.end());
+    keyType *keys = new keyType[sortedEdges.size() + 1];
+    AutoDeleter<keyType> deleteKeys(keys);
+    copy(sortedEdges.begin(), sortedEdges.end(), keys);
+    keys[sortedEdges.size()] = KEY_INVALID;
+    QueryResult res;
+    doGetElemsByKeys(res, keys, fltEdge, tr, omitFailed);
+    unordered_map<keyType, shared_ptr<GraphElem>> local;
+    unordered_map<keyType, shared_ptr<GraphElem>> &matching = read == nullptr ? local : *read;
+    for(auto &edge : res) {
+        matching[edge->getKey()] = edge;
+    }
+    // keep only the matching ones, from was already extended
+    size_t base = from.size() - foundEdges.size();
+    size_t kept = base;
+    for(size_t i = 0; i < foundEdges.size(); i++) {
+        if(matching.find(foundEdges[i]) != matching.end()) {
+            from[kept++] = from[base + i];
+            edges.push_back(foundEdges[i]);
+            others.push_back(foundOthers[i]);
+        }
+    }
+    from.erase(from.begin() + kept, from.end());
+}
+
+void Database::buildPath(deque<shared_ptr<GraphElem>> &path, const deque<keyType> &keys, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, Transaction &tr) {
+    path.push_back(start);
+    for(size_t i = 1; i + 1 < keys.size(); i++) {
+        path.push_back(doRead(keys[i], tr, RCState::FULL));
+    }
+    if(keys.size() > 1) {
+        path.push_back(target);
+    }
+}
+
+double Database::getShortestPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doGetShortestPath(path, start, target, direction, fltEdge, weight, tr, omitFailed);
+}
+
+double Database::getShortestPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    double result = doGetShortestPath(path, start, target, direction, fltEdge, weight, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return result;
+}
+
+double Database::doGetShortestPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, Transaction &tr, bool omitFailed) {
+    doAttach(start, tr, AM::KEEP_PL);
+    doAttach(target, tr, AM::KEEP_PL);
+    keyType startKey = start->getKey();
+    keyType targetKey = target->getKey();
+    typedef pair<double, keyType> QueueItem;
+    priority_queue<QueueItem, vector<QueueItem>, greater<QueueItem>> queue;
+    unordered_map<keyType, double> distance;
+    // node -> (edge, previous node)
+    unordered_map<keyType, pair<keyType, keyType>> parents;
+    unordered_set<keyType> settled;
+    distance[startKey] = 0.0;
+    queue.push(QueueItem(0.0, startKey));
+    while(!queue.empty()) {
+        QueueItem top = queue.top();
+        queue.pop();
+        keyType node = top.second;
+        if(!settled.insert(node).second) {
+            // stale queue item
+            continue;
+        }
+        if(node == targetKey) {
+            break;
+        }
+        deque<keyType> nodes(1, node), from, edges, others;
+        unordered_map<keyType, shared_ptr<GraphElem>> read;
+        expandNodes(nodes, direction, fltEdge, from, edges, others, &read, tr, omitFailed);
+        for(size_t i = 0; i < edges.size(); i++) {
+            if(settled.count(others[i]) > 0) {
+                continue;
+            }
+            double w = weight.weight(read[edges[i]]->pl());
+            if(w < 0.0) {
+                throw IllegalArgumentException("Negative edge weight in shortest path query.");
+            }
+            double d = top.first + w;
+            auto found = distance.find(others[i]);
+            if(found == distance.end() || d < found->second) {
+                distance[others[i]] = d;
+                parents[others[i]] = pair<keyType, keyType>(edges[i], node);
+                queue.push(QueueItem(d, others[i]));
+            }
+        }
+    }
+    if(settled.count(targetKey) == 0) {
+        return numeric_limits<double>::infinity();
+    }
+    deque<keyType> keys(1, targetKey);
+    for(keyType node = targetKey; node != startKey; node = parents[node].second) {
+        keys.push_front(parents[node].first);
+        keys.push_front(parents[node].second);
+    }
+    buildPath(path, keys, start, target, tr);
+    return distance[targetKey];
+}
+
+size_t Database::getFewestHopsPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return doGetFewestHopsPath(path, start, target, direction, fltEdge, tr, omitFailed);
+}
+
+size_t Database::getFewestHopsPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    size_t result = doGetFewestHopsPath(path, start, target, direction, fltEdge, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return result;
+}
+
+size_t Database::doGetFewestHopsPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &start, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    doAttach(start, tr, AM::KEEP_PL);
+    doAttach(target, tr, AM::KEEP_PL);
+    keyType startKey = start->getKey();
+    keyType targetKey = target->getKey();
+    if(startKey == targetKey) {
+        path.push_back(start);
+        return 0;
+    }
+    EdgeEndType reverse = direction == EdgeEndType::In ? EdgeEndType::Out :
+        direction == EdgeEndType::Out ? EdgeEndType::In : direction;
+    // node -> (edge, neighbour towards the side's origin), and the depths
+    unordered_map<keyType, pair<keyType, keyType>> parents[2];
+    unordered_map<keyType, size_t> depths[2];
+    deque<keyType> frontiers[2];
+    parents[0][startKey] = parents[1][targetKey] = pair<keyType, keyType>(KEY_INVALID, KEY_INVALID);
+    depths[0][startKey] = depths[1][targetKey] = 0;
+    frontiers[0].push_back(startKey);
+    frontiers[1].push_back(targetKey);
+    keyType meet = KEY_INVALID;
+    size_t best = 0;
+    while(meet == KEY_INVALID && !frontiers[0].empty() && !frontiers[1].empty()) {
+        int side = frontiers[0].size() <= frontiers[1].size() ? 0 : 1;
+        deque<keyType> from, edges, others, next;
+        expandNodes(frontiers[side], side == 0 ? direction : reverse, fltEdge, from, edges, others, nullptr, tr, omitFailed);
+        // the whole level is processed, because the first meeting may not be the best one
+        for(size_t i = 0; i < edges.size(); i++) {
+            if(parents[side].find(others[i]) != parents[side].end()) {
+                continue;
+            }
+            parents[side][others[i]] = pair<keyType, keyType>(edges[i], from[i]);
+            size_t depth = depths[side][others[i]] = depths[side][from[i]] + 1;
+            auto found = depths[1 - side].find(others[i]);
+            if(found != depths[1 - side].end()) {
+                if(meet == KEY_INVALID || depth + found->second < best) {
+                    meet = others[i];
+                    best = depth + found->second;
+                }
+            }
+            else {
+                next.push_back(others[i]);
+            }
+        }
+        frontiers[side] = move(next);
+    }
+    if(meet == KEY_INVALID) {
+        return GraphElem::NO_PATH;
+    }
+    deque<keyType> keys(1, meet);
+    for(keyType node = meet; node != startKey; node = parents[0][node].second) {
+        keys.push_front(parents[0][node].first);
+        keys.push_front(parents[0][node].second);
+    }
+    for(keyType node = meet; node != targetKey; node = parents[1][node].second) {
+        keys.push_back(parents[1][node].first);
+        keys.push_back(parents[1][node].second);
+    }
+    buildPath(path, keys, start, target, tr);
+    return best;
+}
+
+void Database::matchPatternFromRoot(deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    shared_ptr<GraphElem> root = doRead(KEY_ROOT, tr, RCState::FULL);
+    doMatchPattern(result, root, pattern, anchor, tr, omitFailed);
+}
+
+void Database::matchPatternFromRoot(deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    shared_ptr<GraphElem> root = doRead(KEY_ROOT, tr, RCState::FULL);
+    doMatchPattern(result, root, pattern, anchor, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::matchPattern(deque<PatternMatch> &result, shared_ptr<GraphElem> &start, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    doMatchPattern(result, start, pattern, anchor, tr, omitFailed);
+}
+
+void Database::matchPattern(deque<PatternMatch> &result, shared_ptr<GraphElem> &start, const Pattern &pattern, size_t anchor, bool omitFailed) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    doMatchPattern(result, start, pattern, anchor, tr, omitFailed);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+}
+
+void Database::doMatchPattern(deque<PatternMatch> &result, shared_ptr<GraphElem> &start, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed) {
+    if(anchor >= pattern.getNodeCount()) {
+        throw IllegalArgumentException("Invalid anchor node for pattern.");
+    }
+    // every pattern node must be reachable from the anchor
+    deque<bool> reached(pattern.getNodeCount(), false);
+    reached[anchor] = true;
+    bool extended = true;
+    while(extended) {
+        extended = false;
+        for(auto &ends : pattern.edgeEnds) {
+            if(reached[ends.first] != reached[ends.second]) {
+                reached[ends.first] = reached[ends.second] = true;
+                extended = true;
+            }
+        }
+    }
+    if(find(reached.begin(), reached.end(), false) != reached.end()) {
+        throw IllegalArgumentException("Pattern is not connected.");
+    }
+    doAttach(start, tr, AM::KEEP_PL);
+    if(start->getKey() != KEY_ROOT) {
+        Filter &flt = *pattern.nodeFilters[anchor];
+        if(!flt.matchHead(start->getHeadFields()) || !flt.match(start->pl())) {
+            return;
+        }
+    }
+    PatternSearch search(pattern, tr, omitFailed, result);
+    search.binding.nodes[anchor] = start;
+    search.boundNodes.insert(start->getKey());
+    matchPatternStep(search);
+}
+
+countType Database::patternDegree(PatternSearch &search, keyType node, EdgeEndType direction) {
+    pair<keyType, int> key(node, static_cast<int>(direction));
+    auto found = search.degrees.find(key);
+    if(found != search.degrees.end()) {
+        return found->second;
+    }
+    countType degree = doGetDegree(node, direction, search.tr);
+    search.degrees[key] = degree;
+    return degree;
+}
+
+deque<pair<shared_ptr<GraphElem>, keyType>>& Database::patternSteps(PatternSearch &search, keyType node, size_t edgeIdx, int side) {
+    pair<keyType, size_t> key(node, 2 * edgeIdx + side);
+    auto found = search.steps.find(key);
+    if(found != search.steps.end()) {
+        return found->second;
+    }
+    EdgeEndType direction = search.pattern.edgeDirections[edgeIdx];
+    if(side == 1) {
+        direction = direction == EdgeEndType::In ? EdgeEndType::Out :
+            direction == EdgeEndType::Out ? EdgeEndType::In : direction;
+    }
+    deque<keyType> nodes(1, node), from, edges, others;
+    unordered_map<keyType, shared_ptr<GraphElem>> read;
+    expandNodes(nodes, direction, *search.pattern.edgeFilters[edgeIdx], from, edges, others, &read, search.tr, search.omitFailed);
+    deque<pair<shared_ptr<GraphElem>, keyType>> &steps = search.steps[key];
+    for(size_t i = 0; i < edges.size(); i++) {
+        steps.push_back(pair<shared_ptr<GraphElem>, keyType>(read[edges[i]], others[i]));
+    }
+    return steps;
+}
+
+void Database::matchPatternStep(PatternSearch &search) {
+    const Pattern &pattern = search.pattern;
+    if(search.doneCount == pattern.getEdgeCount()) {
+        search.result.push_back(search.binding);
+        return;
+    }
+    size_t chosen = pattern.getEdgeCount();
+    countType bestCost = 0;
+    for(size_t e = 0; e < pattern.getEdgeCount(); e++) {
+        if(search.edgeDone[e]) {
+            continue;
+        }
+        const pair<size_t, size_t> &ends = pattern.edgeEnds[e];
+        shared_ptr<GraphElem> &first = search.binding.nodes[ends.first];
+        shared_ptr<GraphElem> &second = search.binding.nodes[ends.second];
+        if(!first && !second) {
+            continue;
+        }
+        countType cost = 0;
+        if(!first || !second) {
+            // one more than the degree to let closing edges go first
+            EdgeEndType direction = pattern.edgeDirections[e];
+            if(!first) {
+                direction = direction == EdgeEndType::In ? EdgeEndType::Out :
+                    direction == EdgeEndType::Out ? EdgeEndType::In : direction;
+            }
+            cost = 1 + patternDegree(search, (first ? first : second)->getKey(), direction);
+        }
+        if(chosen == pattern.getEdgeCount() || cost < bestCost) {
+            chosen = e;
+            bestCost = cost;
+        }
+    }
+    const pair<size_t, size_t> &ends = pattern.edgeEnds[chosen];
+    int side = search.binding.nodes[ends.first] ? 0 : 1;
+    size_t otherIdx = side == 0 ? ends.second : ends.first;
+    keyType boundKey = search.binding.nodes[side == 0 ? ends.first : ends.second]->getKey();
+    deque<pair<shared_ptr<GraphElem>, keyType>> &steps = patternSteps(search, boundKey, chosen, side);
+    bool closing = static_cast<bool>(search.binding.nodes[otherIdx]);
+    if(!closing) {
+        // read the unknown candidates for the other end in one batch
+        deque<keyType> toRead;
+        for(auto &step : steps) {
+            pair<keyType, size_t> key(step.second, otherIdx);
+            if(step.second != KEY_ROOT && search.nodes.find(key) == search.nodes.end()) {
+                toRead.push_back(step.second);
+                search.nodes[key] = shared_ptr<GraphElem>();
+            }
+        }
+        if(toRead.size() > 0) {
+            sort(toRead.begin(), toRead.end());
+            keyType *keys = new keyType[toRead.size() + 1];
+            AutoDeleter<keyType> deleteKeys(keys);
+            copy(toRead.begin(), toRead.end(), keys);
+            keys[toRead.size()] = KEY_INVALID;
+            QueryResult res;
+            doGetElemsByKeys(res, keys, *pattern.nodeFilters[otherIdx], search.tr, search.omitFailed);
+            for(auto &node : res) {
+                search.nodes[pair<keyType, size_t>(node->getKey(), otherIdx)] = node;
+            }
+        }
+    }
+    search.edgeDone[chosen] = true;
+    search.doneCount++;
+    for(auto &step : steps) {
+        keyType edgeKey = step.first->getKey();
+        if(search.boundEdges.count(edgeKey) > 0) {
+            continue;
+        }
+        if(closing) {
+            if(step.second != search.binding.nodes[otherIdx]->getKey()) {
+                continue;
+            }
+        }
+        else {
+            auto found = search.nodes.find(pair<keyType, size_t>(step.second, otherIdx));
+            if(found == search.nodes.end() || !found->second || search.boundNodes.count(step.second) > 0) {
+                continue;
+            }
+            search.binding.nodes[otherIdx] = found->second;
+            search.boundNodes.insert(step.second);
+        }
+        search.binding.edges[chosen] = step.first;
+        search.boundEdges.insert(edgeKey);
+        matchPatternStep(search);
+        search.boundEdges.erase(edgeKey);
+        search.binding.edges[chosen].reset();
+        if(!closing) {
+            search.boundNodes.erase(step.second);
+            search.binding.nodes[otherIdx].reset();
+        }
+    }
+    search.edgeDone[chosen] = false;
+    search.doneCount--;
+}
+
+shared_ptr<GraphElem> Database::getStart(shared_ptr<GraphElem> &ge, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return ge->doGetStart(tr);
+}
+
+shared_ptr<GraphElem> Database::getStart(shared_ptr<GraphElem> &ge) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    shared_ptr<GraphElem> ret = ge->doGetStart(tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+shared_ptr<GraphElem> Database::getEnd(shared_ptr<GraphElem> &ge, Transaction &tr) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    return ge->doGetEnd(tr);
+}
+
+shared_ptr<GraphElem> Database::getEnd(shared_ptr<GraphElem> &ge) {
+    lock_guard<mutex> lck(accessMtx);
+    isReady();
+    Transaction tr = doBeginTrans(TT::RO, true);
+    shared_ptr<GraphElem> ret = ge->doGetEnd(tr);
+    doEndTrans(tr, TransactionEnd::COMMIT);
+    return ret;
+}
+
+/*ups_txn_t *Database::getUpsTr(Transaction &tr) {
+    auto foundUpsTrans = upsTransactions.find(tr.getHandle());
+    return foundUpsTrans->second;
+}*/
+
+keyType Database::getFirstFreeKey() {
+    ups_key_t key;
+    keyType needle = 0;
+    key.data = &needle;
+    key.flags = UPS_KEY_USER_ALLOC;
+    ups_record_t found;
+    int bitCount = (key.size = sizeof(keyType)) * 8;
+    for(int i = bitCount - 1; i >= 0; i--) {
+        keyType prevNeedle = needle;
+        needle |= (1 << i);
+        found.size = found.flags = found.partial_offset = found.partial_size = 0;
+        found.data = nullptr;
+        ups_status_t st = _ups_db_find(db, nullptr, &key, &found, UPS_FIND_GEQ_MATCH);
+        switch(st) {
+        case UPS_SUCCESS:
+            // nothing to do, needle already has the bit set.
+            break;
+        case UPS_KEY_NOT_FOUND:
+            // reset the previous value
+            needle = prevNeedle;
+            break;
+        default:
+            throw UpsException(st);
+        }
+    }
+    return needle + 1;
+}
+
+transHandleType Transaction::counter = TR_NOMORE;
+
 Transaction::~Transaction() {
     if(alreadyLocked) {
         db.lock()->doEndTrans(*this, TransactionEnd::ABORT_KEEP_PL);
@@ -738,8 +2937,20 @@ void Transaction::abort(TE te) {
 
 Filter Filter::defaultFilter;
 
+EdgeWeight EdgeWeight::defaultWeight;
+
 map<payloadType, PayloadTypeFilter> PayloadTypeFilter::store;
 
+bool Filter::matchHead(const HeadFields &head) const noexcept {
+    payloadType pt = getPayloadType();
+    return pt == PT_ANY || head.type == pt;
+}
+
+bool Filter::matchesByTypeOnly() const noexcept {
+    // user subclasses may look into the payload
+    return typeid(*this) == typeid(Filter) || typeid(*this) == typeid(PayloadTypeFilter);
+}
+
 PayloadTypeFilter& PayloadTypeFilter::get(payloadType pt) {
     auto found = store.find(pt);
     if(found == store.end()) {
@@ -751,6 +2962,8 @@ PayloadTypeFilter& PayloadTypeFilter::get(payloadType pt) {
     }
 }
 
+constexpr size_t GraphElem::NO_PATH;
+
 GraphElem::GraphElem(shared_ptr<Database> &d, RecordType rt, unique_ptr<Payload> pl) :
     db(d), recordType(rt), payload(std::move(pl)), chainOrig(rt, payload->getType()), chainNew(rt, payload->getType()),
     converter(Converter(chainNew)) {
@@ -825,6 +3038,216 @@ void GraphElem::getNeighbours(QueryResult &res, EdgeEndType direction, Filter &f
     db.lock()->getNeighbours(res, ge, direction, fltEdge, fltNode, omitFailed);
 }
 
+void GraphElem::getEdgesBetween(QueryResult &res, shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    assureNode();
+    other->assureNodeOrRoot();
+    auto ge = shared_from_this();
+    db.lock()->getEdgesBetween(res, ge, other, direction, fltEdge, tr, omitFailed);
+}
+
+void GraphElem::getEdgesBetween(QueryResult &res, shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    assureNode();
+    other->assureNodeOrRoot();
+    auto ge = shared_from_this();
+    db.lock()->getEdgesBetween(res, ge, other, direction, fltEdge, omitFailed);
+}
+
+EdgeCursor GraphElem::getEdgeCursor(EdgeEndType direction, Filter &fltEdge, Transaction &tr, size_t limit, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getEdgeCursor(ge, direction, fltEdge, tr, limit, omitFailed);
+}
+
+OrderedEdgeCursor GraphElem::getOrderedEdgeCursor(uint16_t indexId, EdgeEndType direction, const FieldRange &range, Filter &fltEdge,
+        Transaction &tr, size_t limit, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getOrderedEdgeCursor(ge, indexId, direction, range, fltEdge, tr, limit, omitFailed);
+}
+
+shared_ptr<GraphElem> GraphElem::getFirstEdge(EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    return getEdgeCursor(direction, fltEdge, tr, 1, omitFailed).next();
+}
+
+void GraphElem::traverse(deque<QueryResult> &levels, const deque<Hop> &hops, Transaction &tr, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    db.lock()->traverse(ge, levels, hops, tr, omitFailed);
+}
+
+void GraphElem::traverse(deque<QueryResult> &levels, const deque<Hop> &hops, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    db.lock()->traverse(ge, levels, hops, omitFailed);
+}
+
+double GraphElem::getShortestPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, Transaction &tr, bool omitFailed) {
+    assureNode();
+    target->assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getShortestPath(path, ge, target, direction, fltEdge, weight, tr, omitFailed);
+}
+
+double GraphElem::getShortestPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, bool omitFailed) {
+    assureNode();
+    target->assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getShortestPath(path, ge, target, direction, fltEdge, weight, omitFailed);
+}
+
+size_t GraphElem::getFewestHopsPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    assureNode();
+    target->assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getFewestHopsPath(path, ge, target, direction, fltEdge, tr, omitFailed);
+}
+
+size_t GraphElem::getFewestHopsPath(deque<shared_ptr<GraphElem>> &path, shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    assureNode();
+    target->assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getFewestHopsPath(path, ge, target, direction, fltEdge, omitFailed);
+}
+
+void GraphElem::matchPattern(deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    db.lock()->matchPattern(result, ge, pattern, anchor, tr, omitFailed);
+}
+
+void GraphElem::matchPattern(deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    db.lock()->matchPattern(result, ge, pattern, anchor, omitFailed);
+}
+
+size_t Pattern::addNode(Filter &flt) {
+    nodeFilters.push_back(&flt);
+    return nodeFilters.size() - 1;
+}
+
+size_t Pattern::addEdge(size_t from, size_t to, EdgeEndType direction, Filter &flt) {
+    if(from >= nodeFilters.size() || to >= nodeFilters.size() || from == to) {
+        throw IllegalArgumentException("Invalid pattern edge ends.");
+    }
+    edgeEnds.push_back(pair<size_t, size_t>(from, to));
+    edgeDirections.push_back(direction);
+    edgeFilters.push_back(&flt);
+    return edgeFilters.size() - 1;
+}
+
+size_t CSRGraph::findNode(keyType key) const noexcept {
+    auto found = lower_bound(nodeKeys.begin(), nodeKeys.end(), key);
+    return found != nodeKeys.end() && *found == key ? found - nodeKeys.begin() : nodeKeys.size();
+}
+
+void CSRGraph::clear() noexcept {
+    nodeKeys.clear();
+    nodeTypes.clear();
+    offsets.clear();
+    targets.clear();
+    edgeKeys.clear();
+    edgeTypes.clear();
+    directed.clear();
+}
+
+void OrphanReport::clear() noexcept {
+    nodes.clear();
+    edges.clear();
+    strayRecords.clear();
+    removed = false;
+}
+
+shared_ptr<GraphElem> EdgeCursor::next() {
+    return db.lock()->cursorNext(*this);
+}
+
+shared_ptr<GraphElem> ExtentCursor::next() {
+    return db.lock()->extentNext(*this);
+}
+
+shared_ptr<GraphElem> FieldCursor::next() {
+    return db.lock()->fieldNext(*this);
+}
+
+shared_ptr<GraphElem> OrderedEdgeCursor::next() {
+    return db.lock()->orderedEdgeNext(*this);
+}
+
+bool GraphElem::existsEdge(shared_ptr<GraphElem> &other, EdgeEndType direction, Transaction &tr) {
+    assureNode();
+    other->assureNodeOrRoot();
+    auto ge = shared_from_this();
+    return db.lock()->existsEdge(ge, other, direction, tr);
+}
+
+bool GraphElem::existsEdge(shared_ptr<GraphElem> &other, EdgeEndType direction) {
+    assureNode();
+    other->assureNodeOrRoot();
+    auto ge = shared_from_this();
+    return db.lock()->existsEdge(ge, other, direction);
+}
+
+bool GraphElem::existsEdgeOfType(EdgeEndType direction, payloadType pt, Transaction &tr) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->existsEdgeOfType(ge, direction, pt, tr);
+}
+
+bool GraphElem::existsEdgeOfType(EdgeEndType direction, payloadType pt) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->existsEdgeOfType(ge, direction, pt);
+}
+
+size_t GraphElem::countEdges(EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->countEdges(ge, direction, fltEdge, tr, omitFailed);
+}
+
+size_t GraphElem::countEdges(EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->countEdges(ge, direction, fltEdge, omitFailed);
+}
+
+bool GraphElem::anyEdge(EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->anyEdge(ge, direction, fltEdge, tr, omitFailed);
+}
+
+bool GraphElem::anyEdge(EdgeEndType direction, Filter &fltEdge, bool omitFailed) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->anyEdge(ge, direction, fltEdge, omitFailed);
+}
+
+EdgeAggregate GraphElem::getAggregate(uint16_t indexId, EdgeEndType direction, Transaction &tr) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getAggregate(ge, indexId, direction, tr);
+}
+
+EdgeAggregate GraphElem::getAggregate(uint16_t indexId, EdgeEndType direction) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getAggregate(ge, indexId, direction);
+}
+
+countType GraphElem::getDegree(EdgeEndType direction, Transaction &tr) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getDegree(ge, direction, tr);
+}
+
+countType GraphElem::getDegree(EdgeEndType direction) {
+    assureNode();
+    auto ge = shared_from_this();
+    return db.lock()->getDegree(ge, direction);
+}
+
 shared_ptr<GraphElem> GraphElem::getStart(Transaction &tr) {
     assureEdge();
     auto ge = shared_from_this();
@@ -855,6 +3278,28 @@ void GraphElem::assureNode() const {
     }
 }
 
+HeadFields GraphElem::getHeadFields() const {
+    HeadFields head;
+    head.key = key;
+    head.recordType = recordType;
+    head.type = payload->getType();
+    head.aclKey = aclKey;
+    if(recordType == RT_DEDGE || recordType == RT_UEDGE) {
+        head.start = chainNew.getHeadField(FPE_NODE_START);
+        head.end = chainNew.getHeadField(FPE_NODE_END);
+    }
+    else {
+        head.start = head.end = KEY_INVALID;
+    }
+    return head;
+}
+
+void GraphElem::assureNodeOrRoot() const {
+    if(dynamic_cast<const AbstractNode*>(this) == nullptr) {
+        throw IllegalArgumentException("The other end must be a node.");
+    }
+}
+
 void GraphElem::assureEdge() const {
     if(dynamic_cast<const Edge*>(this) == nullptr) {
         throw IllegalMethodException("This method may only be called on an Edge.");
@@ -1057,6 +3502,14 @@ void AbstractNode::addEdge(FieldPosNode where, keyType edgeKey, ups_txn_t *tr) {
     chainNew.addEdge(where, edgeKey, tr);
 }
 
+void AbstractNode::addEdges(FieldPosNode where, const deque<keyType> &keys, ups_txn_t *tr) {
+    if(chainNew.getState() < RCState::PARTIAL) {
+        // make sure we have the edge arrays
+        chainNew.load(key, tr, RCState::PARTIAL);
+    }
+    chainNew.addEdges(where, keys, tr);
+}
+
 Root::Root(shared_ptr<Database> d, uint32_t vmaj, uint32_t vmin, string name) :
     AbstractNode(d, RT_ROOT, unique_ptr<Payload>(new EmptyNode(PT_EMPTY_NODE))), verMajor(vmaj), verMinor(vmin), appName(name) {
 }
@@ -1108,14 +3561,28 @@ deque<keyType> Edge::getConnectedElemsBeforeWrite() {
     return result;
 }
 
+void Edge::indexEdge(ups_txn_t *tr) {
+    auto database = db.lock();
+    payloadType pt = payload->getType();
+    keyType start = chainNew.getHeadField(FPE_NODE_START);
+    keyType end = chainNew.getHeadField(FPE_NODE_END);
+    database->edgeEnds.add(key, recordType, pt, start, end, tr);
+    database->adjacency.add(key, recordType, pt, start, end, tr);
+}
+
+void Edge::addToNode(shared_ptr<GraphElem> &node, FieldPosNode where, ups_txn_t *tr) {
+    db.lock()->addEdgeToNode(node, where, key, tr);
+}
+
 void DirEdge::write(deque<shared_ptr<GraphElem>> &connected, ups_txn_t *tr) {
     bool needUpdateEnds = state == GEState::DU;
     GraphElem::write(connected, tr);
     if(needUpdateEnds) {
         // first key is for edge start, the edge comes out of this node
-        dynamic_pointer_cast<AbstractNode>(connected[0])->addEdge(FPN_OUT_BUCKETS, key, tr);
+        addToNode(connected[0], FPN_OUT_BUCKETS, tr);
         // second key is for edge end, the edge goes into this node
-        dynamic_pointer_cast<AbstractNode>(connected[1])->addEdge(FPN_IN_BUCKETS, key, tr);
+        addToNode(connected[1], FPN_IN_BUCKETS, tr);
+        indexEdge(tr);
     }
 }
 
@@ -1123,14 +3590,20 @@ void UndirEdge::write(deque<shared_ptr<GraphElem>> &connected, ups_txn_t *tr) {
     bool needUpdateEnds = state == GEState::DU;
     GraphElem::write(connected, tr);
     if(needUpdateEnds) {
-        dynamic_pointer_cast<AbstractNode>(connected[0])->addEdge(FPN_UN_BUCKETS, key, tr);
-        dynamic_pointer_cast<AbstractNode>(connected[1])->addEdge(FPN_UN_BUCKETS, key, tr);
+        addToNode(connected[0], FPN_UN_BUCKETS, tr);
+        addToNode(connected[1], FPN_UN_BUCKETS, tr);
+        indexEdge(tr);
     }
 }
 
 unordered_map<payloadType, GEFactory::CreatorFunction> GEFactory::registry;
 mutex GEFactory::typeMtx;
 payloadType GEFactory::typeCounter = static_cast<payloadType>(PT_NOMORE);
+deque<pair<payloadType, shared_ptr<FieldExtractor>>> GEFactory::fieldIndexes;
+deque<pair<payloadType, shared_ptr<GeoExtractor>>> GEFactory::geoIndexes;
+deque<VectorIndex::Params> GEFactory::vectorIndexes;
+deque<pair<payloadType, shared_ptr<FieldExtractor>>> GEFactory::edgeOrders;
+deque<pair<payloadType, shared_ptr<ValueExtractor>>> GEFactory::aggregates;
 
 void GEFactory::initStatic() {
     lock_guard<mutex> lck(typeMtx);
@@ -1146,6 +3619,44 @@ payloadType GEFactory::reg(CreatorFunction classCreator) {
     return typeKey;
 }
 
+uint16_t GEFactory::regIndex(payloadType pt, shared_ptr<FieldExtractor> extractor) {
+    lock_guard<mutex> lck(typeMtx);
+    fieldIndexes.push_back(make_pair(pt, extractor));
+    return static_cast<uint16_t>(fieldIndexes.size() - 1);
+}
+
+uint16_t GEFactory::regGeoIndex(payloadType pt, shared_ptr<GeoExtractor> extractor) {
+    lock_guard<mutex> lck(typeMtx);
+    geoIndexes.push_back(make_pair(pt, extractor));
+    return static_cast<uint16_t>(geoIndexes.size() - 1);
+}
+
+uint16_t GEFactory::regVectorIndex(payloadType pt, shared_ptr<VectorExtractor> extractor, VectorMetric metric,
+        uint16_t maxLinks, uint16_t efConstruction, uint16_t efSearch) {
+    lock_guard<mutex> lck(typeMtx);
+    VectorIndex::Params params;
+    params.type = pt;
+    params.extractor = extractor;
+    params.metric = metric;
+    params.maxLinks = maxLinks;
+    params.efConstruction = efConstruction;
+    params.efSearch = efSearch;
+    vectorIndexes.push_back(params);
+    return static_cast<uint16_t>(vectorIndexes.size() - 1);
+}
+
+uint16_t GEFactory::regEdgeOrder(payloadType pt, shared_ptr<FieldExtractor> extractor) {
+    lock_guard<mutex> lck(typeMtx);
+    edgeOrders.push_back(make_pair(pt, extractor));
+    return static_cast<uint16_t>(edgeOrders.size() - 1);
+}
+
+uint16_t GEFactory::regAggregate(payloadType pt, shared_ptr<ValueExtractor> extractor) {
+    lock_guard<mutex> lck(typeMtx);
+    aggregates.push_back(make_pair(pt, extractor));
+    return static_cast<uint16_t>(aggregates.size() - 1);
+}
+
 shared_ptr<GraphElem> GEFactory::create(std::shared_ptr<Database> &db, payloadType typeKey) {
     auto it = registry.find(typeKey);
     if (it != registry.end()) {
@@ -8,6 +8,8 @@ COPYRIGHT COMES HERE
 #define UDB_UDBGRAPH_H
 
 #include<map>
+#include<vector>
+#include<functional>
 #include<unordered_map>
 #include<unordered_set>
 #include<memory>
@@ -19,6 +21,7 @@ COPYRIGHT COMES HERE
 #endif
 
 #include"serializer.h"
+#include"index.h"
 #include"exception.h"
 #include"udbgraph_config.h"
 
@@ -144,6 +147,18 @@ namespace udbgraph {
     class DirEdge;
     class UndirEdge;
     class GEFactory;
+    class EdgeCursor;
+    class ExtentCursor;
+    class FieldCursor;
+    class OrderedEdgeCursor;
+    class Hop;
+    class EdgeWeight;
+    class Pattern;
+    class PatternMatch;
+    class PatternSearch;
+    class CSRGraph;
+    class ScoreSetter;
+    class OrphanReport;
 
     typedef std::unordered_map<transHandleType, ups_txn_t*> upsTransMapType;
     typedef std::unordered_map<keyType, std::shared_ptr<GraphElem>> lockedElemsMapType;
@@ -165,6 +180,51 @@ namespace udbgraph {
         /** The UpscaleDB database in use. */
         ups_db_t *db = nullptr;
 
+        /** Index of edges by their end nodes, stored in the same environment. */
+        EdgeEndIndex edgeEnds;
+
+        /** Adjacency lists partitioned by edge payload type. */
+        AdjacencyIndex adjacency;
+
+        /** Extent index of the nodes and edges by payload type. */
+        TypeIndex types;
+
+        /** Map of the external IDs to node keys. */
+        ExternalIdIndex externalIds;
+
+        /** Descriptors of the payload indexes checked on open. */
+        IndexDescriptors indexDescriptors;
+
+        /** Payload field indexes in the order of GEFactory::regIndex calls, set up
+         * when the environment is opened. */
+        std::deque<std::unique_ptr<FieldIndex>> fieldIndexes;
+
+        /** Spatial indexes in the order of GEFactory::regGeoIndex calls. */
+        std::deque<std::unique_ptr<GeoIndex>> geoIndexes;
+
+        /** Vector indexes in the order of GEFactory::regVectorIndex calls. */
+        std::deque<std::unique_ptr<VectorIndex>> vectorIndexes;
+
+        /** Ordered edge lists in the order of GEFactory::regEdgeOrder calls. */
+        std::deque<std::unique_ptr<EdgeOrderIndex>> edgeOrderIndexes;
+
+        /** Edge aggregates in the order of GEFactory::regAggregate calls. */
+        std::deque<std::unique_ptr<AggregateIndex>> aggregateIndexes;
+
+        /** All payload indexes, to be updated on write. */
+        std::deque<PayloadIndex*> payloadIndexes;
+
+        /** True during a bulk write, when the keys of new edges are collected in
+         * pendingEdges instead of inserting them into the node hash tables one by one. */
+        bool bulkWrite = false;
+
+        /** Keys of new edges waiting for insertion into the hash tables of their
+         * nodes, grouped by node key and hash table (FPN_*_BUCKETS). */
+        std::map<std::pair<keyType, FieldPosNode>, std::deque<keyType>> pendingEdges;
+
+        /** The nodes referenced in pendingEdges. */
+        std::unordered_map<keyType, std::shared_ptr<GraphElem>> pendingNodes;
+
         /** Mutex for accessing UpscaleDB and member structures. UDBGraph offers
         small and quick operations, so making other threads waiting for one operation
         to end won't hurt overall performance much. Moreover, the underlying UpscaleDB
@@ -174,6 +234,10 @@ namespace udbgraph {
         at a time." This means we have not a big room for real concurrency. */
         mutable std::mutex accessMtx;
 
+        /** Threads used by runParallel besides the calling one, see setWorkerThreads.
+         * The analytics use it without holding accessMtx, the pool serializes the jobs. */
+        WorkerPool workerPool;
+
         /** Automatic record index counter holding the next free value.
          * Number 0 is invalid, number 1 is for ACL management, number 2 is the
          * global root node. */
@@ -185,6 +249,9 @@ namespace udbgraph {
         /** Maps transaction handles to sets of GraphElem shared ptrs. */
         transLockedElemsMapType transLockedElems;
 
+        /** Number of the open read-write transactions. */
+        size_t readWriteTransCount = 0;
+
         /** Countrs open read-only transaction for each elem. This, transLockedElems
          * and upsTransactions are the structures to register GraphElems. */
         CounterMap<keyType, size_t> roTransCounter;
@@ -236,6 +303,16 @@ namespace udbgraph {
              ups_set_error_handler(errHand);
         }
 
+        /** Sets the number of threads used to deserialize and filter the graph
+         * elems read in one batch, like the edges or neighbours of a node or a
+        level of a traversal. UpscaleDB access is still serialized, but the payloads
+        are deserialized and Filter::match is evaluated in parallel, so filters
+        must be thread-safe if n > 1. 0 means the number of hardware threads.
+        The default is 1, which uses no extra threads. The extra threads are
+        started here after the running parallel job if any has finished, and
+        reused by all batches until the next call. */
+        void setWorkerThreads(unsigned n);
+
         /** Move constructor disabled. */
         Database(Database &&d) = delete;
 
@@ -294,6 +371,18 @@ namespace udbgraph {
          * missing ones are created. */
         void write(std::shared_ptr<GraphElem> &ge, Transaction &tr);
 
+        /** Writes all the elements in the given order using the specified transaction.
+         * New nodes must precede the edges referring them. The keys of the new edges
+         * are inserted into the hash tables of their nodes at the end, growing each
+         * table at most once and saving each affected record once. This makes
+         * adding many edges to the same node much cheaper. On exception, the
+         * transaction should be aborted. */
+        void write(std::deque<std::shared_ptr<GraphElem>> &elems, Transaction &tr);
+
+        /** Writes all the elements in the given order like the above function
+         * using an on-the-fly transaction. */
+        void write(std::deque<std::shared_ptr<GraphElem>> &elems);
+
         /** Writes (inserts or updates) the element in the database using an on-the-fly
          * transaction. On update, the elem is overwritten in DB and the operation
          * reuses as many records as possible. The excess records are deleted or the
@@ -329,7 +418,247 @@ namespace udbgraph {
          * considering the given filter. May not be called on edges. */
         void getRootEdges(QueryResult &res, EdgeEndType direction, Filter &fltEdge, bool omitFailed = false);
 
+        /** Performs a breadth-first traversal from the root, see GraphElem::traverse. */
+        void traverseFromRoot(std::deque<QueryResult> &levels, const std::deque<Hop> &hops, Transaction &tr, bool omitFailed = true);
+
+        /** Performs a breadth-first traversal from the root using a temporary
+         * transaction, see GraphElem::traverse. */
+        void traverseFromRoot(std::deque<QueryResult> &levels, const std::deque<Hop> &hops, bool omitFailed = true);
+
+        /** Builds a compressed sparse row representation of the whole graph into
+         * csr in one cursor scan over the head records, without creating graph elems.
+        The scan is not part of any transaction, so UpscaleDB would report a
+        conflict on the records changed by an open read-write transaction. The
+        arrays are assembled using the worker threads, see setWorkerThreads.
+        @param withTypes if true, the payload types of the nodes and edges are
+        stored as well.
+        @throws TransactionException if a read-write transaction is open. */
+        void buildCSR(CSRGraph &csr, bool withTypes = false);
+
+        /** Computes the PageRank of the nodes of csr into ranks, indexed like
+         * csr.nodeKeys. Each edge entry of csr is a link, so undirected edges link
+        in both directions. The rank of nodes without links is distributed evenly.
+        The iteration stops when the sum of the absolute changes drops below
+        tolerance or after maxIterations. Uses the worker threads. */
+        void pageRank(const CSRGraph &csr, std::vector<double> &ranks, double damping = 0.85, size_t maxIterations = 100, double tolerance = 1e-9);
+
+        /** Computes the weakly connected components of csr into components, indexed
+         * like csr.nodeKeys. Each node gets the smallest node index in its component.
+        Uses the worker threads. */
+        void connectedComponents(const CSRGraph &csr, std::vector<size_t> &components);
+
+        /** Computes the degree centrality of the nodes of csr into centrality, indexed
+         * like csr.nodeKeys: the number of edges of the given direction divided by
+        the number of other nodes. Uses the worker threads. */
+        void degreeCentrality(const CSRGraph &csr, std::vector<double> &centrality, EdgeEndType direction = EdgeEndType::Any);
+
+        /** Writes values indexed like csr.nodeKeys into the node payloads using
+         * setter. Each transaction reads, updates and writes at most batchSize nodes,
+        and the mutex is released between them, so other threads may modify the
+        nodes in between, and the write is not atomic: if a batch fails, for
+        example because a node was deleted or is locked, the earlier batches stay
+        committed and the exception is rethrown. The root is skipped.
+        @param committed if set, receives the number of values whose batches are
+        committed, also when an exception is thrown, to resume from.
+        @return the number of nodes written. */
+        size_t writeScores(const CSRGraph &csr, const std::vector<double> &values, ScoreSetter &setter, size_t batchSize = 1000, size_t *committed = nullptr);
+
+        /** Lists the nodes not reachable from the root, their edges and the
+         * continuation records not belonging to any record chain. Reachability
+        ignores the edge directions, so an unreachable node has edges only to other
+        unreachable nodes. The records are read in one cursor scan, the reachable
+        nodes are marked in a bitmap by a breadth-first search using the worker
+        threads. This is a maintenance tool, applications must avoid orphaning nodes.
+        @param remove if true, the listed elems are erased together with their
+        record chains and index entries, and the stray records are erased as well.
+        The erasure is committed in batches, each holding whole elems, so if it
+        fails, the elems not erased yet are still found by the next call.
+        @throws TransactionException if a read-write transaction is open, because
+        the scan would conflict with its records, or if remove is true and any
+        transaction is open. */
+        void findOrphans(OrphanReport &report, bool remove = false);
+
+        /** Collects the elems whose value in the field index equals value, see
+         * GEFactory::regIndex. For string values, the whole string must match.
+        @param indexId the id returned by GEFactory::regIndex.
+        @throws DatabaseException if the index is unknown. */
+        void findByField(QueryResult &res, uint16_t indexId, const IndexKey &value, Transaction &tr, bool omitFailed = true);
+
+        /** As findByField above, without explicit transaction. */
+        void findByField(QueryResult &res, uint16_t indexId, const IndexKey &value, bool omitFailed = true);
+
+        /** Collects the elems whose value in the field index is between from and to inclusive.
+         * The values are compared byte-wise, which follows the natural order for values
+        appended with the IndexKey operators.
+        @throws DatabaseException if the index is unknown. */
+        void findByFieldRange(QueryResult &res, uint16_t indexId, const IndexKey &from, const IndexKey &to, Transaction &tr, bool omitFailed = true);
+
+        /** As findByFieldRange above, without explicit transaction. */
+        void findByFieldRange(QueryResult &res, uint16_t indexId, const IndexKey &from, const IndexKey &to, bool omitFailed = true);
+
+        /** Returns a cursor over the nodes or edges having payload type pt in key order.
+         * The keys are read from the extent index in batches and each elem is read
+        only when ExtentCursor::next reaches it, so the memory use does not depend on
+        the number of elems. Elems created by the transaction after a batch was read
+        may be missed.
+        @param limit maximum number of elems to return, 0 means unlimited. */
+        ExtentCursor getExtentCursor(payloadType pt, Filter &flt, Transaction &tr, size_t limit = 0, bool omitFailed = true);
+
+        /** Collects the elems of the spatial index inside the box, see GEFactory::regGeoIndex.
+         * The coordinates are in degrees. If minLon is greater than maxLon, the box
+        crosses the antimeridian.
+        @throws DatabaseException if the index is unknown. */
+        void findInBox(QueryResult &res, uint16_t indexId, double minLat, double minLon, double maxLat, double maxLon, Transaction &tr, bool omitFailed = true);
+
+        /** As findInBox above, without explicit transaction. */
+        void findInBox(QueryResult &res, uint16_t indexId, double minLat, double minLon, double maxLat, double maxLon, bool omitFailed = true);
+
+        /** Appends the at most k elems of the spatial index nearest to the position
+         * into result in ascending order of great-circle distance, and the distances
+        in meters into distances.
+        @throws DatabaseException if the index is unknown. */
+        void findNearest(std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &distances, uint16_t indexId,
+            double latitude, double longitude, size_t k, Transaction &tr, bool omitFailed = true);
+
+        /** As findNearest above, without explicit transaction. */
+        void findNearest(std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &distances, uint16_t indexId,
+            double latitude, double longitude, size_t k, bool omitFailed = true);
+
+        /** Appends the approximately k elems of the vector index nearest to the query
+         * into result in ascending order of distance, and the distances into distances,
+         * see GEFactory::regVectorIndex.
+        @param ef size of the candidate list, larger gives better recall, 0 means the registered default.
+        @throws DatabaseException if the index is unknown.
+        @throws IllegalArgumentException if the query dimension differs from the indexed one. */
+        void findSimilar(std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &distances, uint16_t indexId,
+            const std::vector<float> &query, size_t k, size_t ef, Transaction &tr, bool omitFailed = true);
+
+        /** As findSimilar above, without explicit transaction. */
+        void findSimilar(std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &distances, uint16_t indexId,
+            const std::vector<float> &query, size_t k, size_t ef = 0, bool omitFailed = true);
+
+        /** Returns a cursor over the elems in a field index range in value order, see
+         * GEFactory::regIndex. The index entries are read in batches with UpscaleDB
+        cursors and each elem is read only when FieldCursor::next reaches it, so
+        queries like the first N by value stop early without sorting.
+        @param limit maximum number of elems to return, 0 means unlimited.
+        @throws DatabaseException if the index is unknown. */
+        FieldCursor getFieldCursor(uint16_t indexId, const FieldRange &range, Filter &flt, Transaction &tr, size_t limit = 0, bool omitFailed = true);
+
+        /** Implementation of GraphElem::getOrderedEdgeCursor operating on ge. */
+        OrderedEdgeCursor getOrderedEdgeCursor(std::shared_ptr<GraphElem> &ge, uint16_t indexId, EdgeEndType direction, const FieldRange &range,
+            Filter &fltEdge, Transaction &tr, size_t limit, bool omitFailed);
+
+        /** Writes the new node as the node with the external ID. If the ID is already
+         * mapped, node takes over the key of the mapped node and overwrites it, so
+        its edges remain. Otherwise node is inserted and the ID gets mapped to it in
+        the same transaction. The external ID is assembled with the IndexKey operators.
+        @param node a new node never written before. After the call it is the
+        registered instance of the node in the transaction.
+        @return true if an existing node was updated.
+        @throws IllegalArgumentException if node is not new, or the mapped node has
+        an other payload type or is already used in this transaction. */
+        bool upsertNode(const IndexKey &externalId, std::shared_ptr<GraphElem> &node, Transaction &tr);
+
+        /** As upsertNode above, with an on-the-fly transaction. */
+        bool upsertNode(const IndexKey &externalId, std::shared_ptr<GraphElem> &node);
+
+        /** Looks up the node keys of the external IDs in one call, appending them into
+         * keys in the same order, or KEY_INVALID for the unknown IDs. */
+        void lookupExternalIds(const std::deque<IndexKey> &ids, std::deque<keyType> &keys, Transaction &tr);
+
+        /** As lookupExternalIds above, without explicit transaction. */
+        void lookupExternalIds(const std::deque<IndexKey> &ids, std::deque<keyType> &keys);
+
+        /** Reads the nodes of the external IDs matching fltNode into res, unknown IDs
+         * are skipped. */
+        void getNodesByExternalIds(QueryResult &res, const std::deque<IndexKey> &ids, Filter &fltNode, Transaction &tr, bool omitFailed = true);
+
+        /** Returns the number of nodes and edges having payload type pt without reading them. */
+        size_t countOfType(payloadType pt, Transaction &tr);
+
+        /** As countOfType above, without explicit transaction. */
+        size_t countOfType(payloadType pt);
+
+        /** Fills counts with the number of nodes and edges of each payload type
+         * present, in one scan of the extent index. */
+        void countTypes(std::map<payloadType, size_t> &counts, Transaction &tr);
+
+        /** As countTypes above, without explicit transaction. */
+        void countTypes(std::map<payloadType, size_t> &counts);
+
+        /** Finds the occurrences of pattern with its node anchor bound to the root,
+         * see GraphElem::matchPattern. */
+        void matchPatternFromRoot(std::deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed = true);
+
+        /** Finds the occurrences of pattern with its node anchor bound to the root
+         * using a temporary transaction, see GraphElem::matchPattern. */
+        void matchPatternFromRoot(std::deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, bool omitFailed = true);
+
+        /** Returns the degrees of the given nodes in the same order in the given
+         * direction. Only the head records are read, in ascending key order
+         * for better locality, and nothing gets marked in the transaction.
+         * Throws exception if any of the elems is not a node. */
+        std::deque<countType> getDegrees(const std::deque<std::shared_ptr<GraphElem>> &nodes, EdgeEndType direction, Transaction &tr);
+
+        /** Returns the degrees of the given nodes like the above function using
+         * a temporary transaction. */
+        std::deque<countType> getDegrees(const std::deque<std::shared_ptr<GraphElem>> &nodes, EdgeEndType direction);
+
     protected:
+        /** Opens or creates the index databases. Indexes missing from a database
+         * created by an earlier version are created and filled by scanning all
+         * head records once. Throws DatabaseException if the payload index
+         * registrations do not match the descriptors stored in the database. */
+        void openIndexes(bool creating);
+
+        /** Stores the missing descriptors of the payload indexes and compares the
+         * existing ones, throws DatabaseException on mismatch. */
+        void checkIndexDescriptors();
+
+        /** Returns all index databases maintained in the environment. */
+        std::deque<Index*> getIndexes() {
+            std::deque<Index*> ret{&edgeEnds, &adjacency, &types, &externalIds};
+            ret.insert(ret.end(), payloadIndexes.begin(), payloadIndexes.end());
+            return ret;
+        }
+
+        /** Creates the FieldIndex and GeoIndex instances from the GEFactory registrations. */
+        void setupPayloadIndexes();
+
+        /** Updates the payload indexes of the payload type of the elem just written. */
+        void updatePayloadIndexes(std::shared_ptr<GraphElem> &ge, ups_txn_t *upsTr);
+
+        /** Removes the elem from all payload indexes. */
+        void removeFromPayloadIndexes(keyType key, ups_txn_t *upsTr);
+
+        /** Returns the spatial index with the id or throws DatabaseException if missing. */
+        GeoIndex& getGeoIndex(uint16_t indexId);
+
+        /** See findInBox. */
+        void doFindInBox(QueryResult &res, uint16_t indexId, double minLat, double minLon, double maxLat, double maxLon, Transaction &tr, bool omitFailed);
+
+        /** See findNearest. */
+        void doFindNearest(std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &distances, uint16_t indexId, double latitude, double longitude, size_t k, Transaction &tr, bool omitFailed);
+
+        /** Returns the vector index with the id or throws DatabaseException if missing. */
+        VectorIndex& getVectorIndex(uint16_t indexId);
+
+        /** See findSimilar. */
+        void doFindSimilar(std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &distances, uint16_t indexId,
+            const std::vector<float> &query, size_t k, size_t ef, Transaction &tr, bool omitFailed);
+
+        /** Appends the elems of res into result in the order of keys, and the
+         * corresponding values into resultValues. Keys missing from res are skipped. */
+        static void orderByKeys(QueryResult &res, const std::deque<keyType> &keys, const std::deque<double> &values,
+            std::deque<std::shared_ptr<GraphElem>> &result, std::deque<double> &resultValues);
+
+        /** Returns the field index with the id or throws DatabaseException if missing. */
+        FieldIndex& getFieldIndex(uint16_t indexId);
+
+        /** Fills the freshly created indexes from the existing elems in one scan. */
+        void buildIndexes(std::deque<Index*> &toBuild);
+
         /** See attach. */
         void doAttach(std::shared_ptr<GraphElem> ge, Transaction &tr, AttachMode am);
 
@@ -375,6 +704,9 @@ namespace udbgraph {
         /** Checks ACL for the given elem. Now only checks if the ACL key is ACL_FREE. */
         void checkACL(std::shared_ptr<GraphElem> &ge, Transaction &tr) const;
 
+        /** Checks ACL for an elem having the given ACL key. */
+        void checkACL(keyType aclKey, Transaction &tr) const;
+
         /** Checks ACL for all elems. If the elems are registered here, check is
          * done using this, otherwise it reads them partially to reach the ACL key.
          * Registration is needed anyway. This function call does not alter anything
@@ -388,6 +720,20 @@ namespace udbgraph {
         /** Registers the elem in the appropriate structures. */
         void registerElem(std::shared_ptr<GraphElem> &ge, transLockedElemsMapType::iterator &foundLockedElems, Transaction &tr);
 
+        /** Looks up the head record of the key and returns its content, which is
+         * valid until the next UpscaleDB operation in the transaction. Throws
+         * ExistenceException if not found. */
+        uint8_t* findHead(keyType key, ups_txn_t *upsTr);
+
+        /** Checks if the elem with the key may be read in tr without registering it:
+         * it must not be held by a clashing transaction and its ACL must allow
+        access. Returns the head record as findHead does. */
+        uint8_t* checkUnregisteredRead(keyType key, Transaction &tr);
+
+        /** Creates the graph elem identified by the key known to be missing from the
+         * registry containing only its head record, without deserializing. */
+        std::shared_ptr<GraphElem> doBareHead(keyType key, ups_txn_t *upsTr);
+
         /** Reads the graph elem identified by the key known to be missing from the
          * registry to the given record chain level. */
         std::shared_ptr<GraphElem> doBareRead(keyType key, RCState level, ups_txn_t *upsTr);
@@ -398,6 +744,46 @@ namespace udbgraph {
         /** Performs actual write. */
         void doWrite(std::shared_ptr<GraphElem> &ge, Transaction &tr);
 
+        /** Attaches ge and returns the keys of its edges in the given direction.
+         * If fltEdge restricts the payload type, only the edges of that type
+        are looked up in the adjacency index.
+        @return the keys delimited by KEY_INVALID, the caller must free the array. */
+        keyType* doGetEdgeKeys(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr);
+
+        /** Implementation of GraphElem::getEdgeCursor operating on ge. */
+        EdgeCursor getEdgeCursor(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, size_t limit, bool omitFailed);
+
+        /** Implementation of EdgeCursor::next. */
+        std::shared_ptr<GraphElem> cursorNext(EdgeCursor &cursor);
+
+        /** Implementation of ExtentCursor::next. */
+        std::shared_ptr<GraphElem> extentNext(ExtentCursor &cursor);
+
+        /** See upsertNode. */
+        bool doUpsertNode(const IndexKey &externalId, std::shared_ptr<GraphElem> &node, Transaction &tr);
+
+        /** Implementation of FieldCursor::next. */
+        std::shared_ptr<GraphElem> fieldNext(FieldCursor &cursor);
+
+        /** Returns the edge order index with the id or throws DatabaseException if missing. */
+        EdgeOrderIndex& getEdgeOrderIndex(uint16_t indexId);
+
+        /** Implementation of OrderedEdgeCursor::next. */
+        std::shared_ptr<GraphElem> orderedEdgeNext(OrderedEdgeCursor &cursor);
+
+        /** Returns the UpscaleDB transaction of tr after checking it. */
+        ups_txn_t* getUpsTrans(Transaction &tr);
+
+        /** Performs actual bulk write. */
+        void doWrite(std::deque<std::shared_ptr<GraphElem>> &elems, Transaction &tr);
+
+        /** Inserts the edge key into the given hash table of node, or only
+         * queues it during a bulk write. */
+        void addEdgeToNode(std::shared_ptr<GraphElem> &node, FieldPosNode where, keyType edge, ups_txn_t *tr);
+
+        /** Inserts the queued edge keys into their nodes at the end of a bulk write. */
+        void flushPendingEdges(ups_txn_t *tr);
+
         /** Implementation of GraphElem::getEdges(QueryResult&, direction, &fltEdge, Transaction&)
          * operating on the node identified by key. */
         void getEdges(QueryResult &res, std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = false);
@@ -422,6 +808,88 @@ namespace udbgraph {
          * operating on ge. */
         void doGetNeighbours(QueryResult &res, std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Filter &fltNode, Transaction &tr, bool omitFailed = false);
 
+        /** Appends the keys of the nodes connected to ge by edges of the given
+         * direction matching fltEdge into nodeKeys. The edges are read only if
+        fltEdge needs their payload. May contain duplicates and the root. */
+        void collectNeighbourKeys(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, std::deque<keyType> &nodeKeys, Transaction &tr, bool omitFailed);
+
+        /** Removes duplicates, the root and the keys in exclude (if not nullptr) from
+         * nodeKeys, then reads the remaining nodes in key order into res if they
+         * match fltNode. */
+        void loadNeighbours(QueryResult &res, std::deque<keyType> &nodeKeys, Filter &fltNode, Transaction &tr, bool omitFailed, const std::unordered_set<keyType> *exclude = nullptr);
+
+        /** Calls work(begin, end) for consecutive chunks of the range [0, count)
+         * using the calling thread and those of workerPool.
+        The threads take the chunks from a common counter until all are processed.
+        The first exception thrown by a worker is rethrown after all of them have finished. */
+        void runParallel(size_t count, size_t chunk, const std::function<void(size_t, size_t)> &work);
+
+        /** Deserializes the fully read elems and sets matched[i] to 1 if elems[i]
+         * matches flt, in parallel using runParallel. */
+        void deserializeAndMatch(std::deque<std::shared_ptr<GraphElem>> &elems, std::deque<uint8_t> &matched, Filter &flt);
+
+        /** Implementation of GraphElem::traverse operating on start. */
+        void doTraverse(std::shared_ptr<GraphElem> &start, std::deque<QueryResult> &levels, const std::deque<Hop> &hops, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::traverse with transaction. */
+        void traverse(std::shared_ptr<GraphElem> &start, std::deque<QueryResult> &levels, const std::deque<Hop> &hops, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::traverse without transaction. */
+        void traverse(std::shared_ptr<GraphElem> &start, std::deque<QueryResult> &levels, const std::deque<Hop> &hops, bool omitFailed);
+
+        /** Collects the edges of the given direction matching fltEdge at each
+         * node in nodes. For each edge the originating node, the edge and the
+        other node is appended to from, edges and others respectively. The edges
+        are read in one batch only if fltEdge needs their payload or read is not
+        nullptr. In the latter case the read edges are put into read. */
+        void expandNodes(const std::deque<keyType> &nodes, EdgeEndType direction, Filter &fltEdge, std::deque<keyType> &from, std::deque<keyType> &edges, std::deque<keyType> &others, std::unordered_map<keyType, std::shared_ptr<GraphElem>> *read, Transaction &tr, bool omitFailed);
+
+        /** Reads the graph elems of a path given as alternating node and edge keys
+         * into path, taking the first and last node from start and target. */
+        void buildPath(std::deque<std::shared_ptr<GraphElem>> &path, const std::deque<keyType> &keys, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, Transaction &tr);
+
+        /** Implementation of GraphElem::getShortestPath using Dijkstra's algorithm. */
+        double doGetShortestPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::getShortestPath with transaction. */
+        double getShortestPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::getShortestPath without transaction. */
+        double getShortestPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, bool omitFailed);
+
+        /** Implementation of GraphElem::getFewestHopsPath using bidirectional
+         * breadth-first search. */
+        size_t doGetFewestHopsPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::getFewestHopsPath with transaction. */
+        size_t getFewestHopsPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::getFewestHopsPath without transaction. */
+        size_t getFewestHopsPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &start, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, bool omitFailed);
+
+        /** Implementation of GraphElem::matchPattern operating on start. */
+        void doMatchPattern(std::deque<PatternMatch> &result, std::shared_ptr<GraphElem> &start, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::matchPattern with transaction. */
+        void matchPattern(std::deque<PatternMatch> &result, std::shared_ptr<GraphElem> &start, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::matchPattern without transaction. */
+        void matchPattern(std::deque<PatternMatch> &result, std::shared_ptr<GraphElem> &start, const Pattern &pattern, size_t anchor, bool omitFailed);
+
+        /** Binds the next pattern edge in every possible way and recurses until
+         * all edges are bound. Edges closing a cycle are checked first, then the
+        edge leaving the bound node of smallest degree in the edge direction. */
+        void matchPatternStep(PatternSearch &search);
+
+        /** Returns the degree of the node in the direction, read from the head
+         * once per search. */
+        countType patternDegree(PatternSearch &search, keyType node, EdgeEndType direction);
+
+        /** Returns the edges matching pattern edge edgeIdx at node together with
+         * their other ends, reading them in one batch once per search.
+        @param side 0 if node is bound to the first end of the pattern edge, 1 otherwise. */
+        std::deque<std::pair<std::shared_ptr<GraphElem>, keyType>>& patternSteps(PatternSearch &search, keyType node, size_t edgeIdx, int side);
+
         /** Implementation of GraphElem::getStart(Transaction &tr)
          * operating on the edge identifierd by key. */
         std::shared_ptr<GraphElem> getStart(std::shared_ptr<GraphElem> &ge, Transaction &tr);
@@ -430,6 +898,111 @@ namespace udbgraph {
          * operating on the edge identifierd by key. */
         std::shared_ptr<GraphElem> getStart(std::shared_ptr<GraphElem> &ge);
 
+        /** Collects the elems in keys into res which match flt. First only the head
+         * records are read and checked with Filter::matchHead, the survivors are read
+         * fully and checked with Filter::match. All elems are checked before anything
+         * is registered, and only the returned ones get registered in the transaction.
+         * See doGetEdges for omitFailed. keys is delimited by KEY_INVALID. */
+        void doGetElemsByKeys(QueryResult &res, const keyType *keys, Filter &flt, Transaction &tr, bool omitFailed);
+
+        /** Reads the elems of the field index lookup, between from and to if range is set. */
+        void doFindByField(QueryResult &res, uint16_t indexId, const IndexKey &from, const IndexKey *to, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::getEdgesBetween(QueryResult&, std::shared_ptr<GraphElem>&, EdgeEndType, Filter&, Transaction&)
+         * operating on ge. */
+        void getEdgesBetween(QueryResult &res, std::shared_ptr<GraphElem> &ge, std::shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = true);
+
+        /** Implementation of GraphElem::getEdgesBetween(QueryResult&, std::shared_ptr<GraphElem>&, EdgeEndType, Filter&)
+         * operating on ge. */
+        void getEdgesBetween(QueryResult &res, std::shared_ptr<GraphElem> &ge, std::shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, bool omitFailed = true);
+
+        /** Implementation of GraphElem::existsEdge(std::shared_ptr<GraphElem>&, EdgeEndType, Transaction&)
+         * operating on ge. */
+        bool existsEdge(std::shared_ptr<GraphElem> &ge, std::shared_ptr<GraphElem> &other, EdgeEndType direction, Transaction &tr);
+
+        /** Implementation of GraphElem::existsEdge(std::shared_ptr<GraphElem>&, EdgeEndType)
+         * operating on ge. */
+        bool existsEdge(std::shared_ptr<GraphElem> &ge, std::shared_ptr<GraphElem> &other, EdgeEndType direction);
+
+        /** Implementation of GraphElem::existsEdgeOfType(EdgeEndType, payloadType, Transaction&)
+         * operating on ge. */
+        bool existsEdgeOfType(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, payloadType pt, Transaction &tr);
+
+        /** Implementation of GraphElem::existsEdgeOfType(EdgeEndType, payloadType)
+         * operating on ge. */
+        bool existsEdgeOfType(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, payloadType pt);
+
+        /** Checks the adjacency index for an edge of type pt in direction after
+         * checking the node with checkUnregisteredRead. */
+        bool doExistsEdgeOfType(keyType node, EdgeEndType direction, payloadType pt, Transaction &tr);
+
+        /** Implementation of GraphElem::countEdges(EdgeEndType, Filter&, Transaction&, bool)
+         * operating on ge. */
+        size_t countEdges(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::countEdges(EdgeEndType, Filter&, bool)
+         * operating on ge. */
+        size_t countEdges(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, bool omitFailed);
+
+        /** Implementation of GraphElem::anyEdge(EdgeEndType, Filter&, Transaction&, bool)
+         * operating on ge. */
+        bool anyEdge(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed);
+
+        /** Implementation of GraphElem::anyEdge(EdgeEndType, Filter&, bool)
+         * operating on ge. */
+        bool anyEdge(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Filter &fltEdge, bool omitFailed);
+
+        /** Counts the edges of the node matching fltEdge up to max without
+         * registering anything in the transaction, see GraphElem::countEdges. */
+        size_t doCountEdges(keyType node, EdgeEndType direction, Filter &fltEdge, Transaction &tr, size_t max, bool omitFailed);
+
+        /** Implementation of GraphElem::getAggregate(uint16_t, EdgeEndType, Transaction&)
+         * operating on ge. */
+        EdgeAggregate getAggregate(std::shared_ptr<GraphElem> &ge, uint16_t indexId, EdgeEndType direction, Transaction &tr);
+
+        /** Implementation of GraphElem::getAggregate(uint16_t, EdgeEndType)
+         * operating on ge. */
+        EdgeAggregate getAggregate(std::shared_ptr<GraphElem> &ge, uint16_t indexId, EdgeEndType direction);
+
+        /** Returns the aggregate index with the id or throws DatabaseException if missing. */
+        AggregateIndex& getAggregateIndex(uint16_t indexId);
+
+        /** Returns the EdgeEndBits of the direction. */
+        static uint8_t endBits(EdgeEndType direction);
+
+        /** Looks up the keys of edges between the nodes with keys from and to in
+         * edgeEnds. direction is seen from the node from.
+        @param onlyFirst stop at the first edge found.
+        @return the keys delimited by KEY_INVALID, the caller must free the array. */
+        keyType* doGetEdgeKeysBetween(keyType from, keyType to, EdgeEndType direction, Transaction &tr, bool onlyFirst = false);
+
+        /** Looks up the keys of the edges of the node with the given key
+         * having the payload type pt in the adjacency index.
+        @return the keys delimited by KEY_INVALID, the caller must free the array. */
+        keyType* doGetEdgeKeysOfType(keyType node, EdgeEndType direction, payloadType pt, Transaction &tr);
+
+        /** Appends the keys of the edges of the node having the payload type pt
+         * (PT_ANY for all) into edges using the adjacency index. If others is not
+         * nullptr, the keys of the nodes at the other ends are appended there in
+         * the same order. */
+        void collectAdjacent(keyType node, EdgeEndType direction, payloadType pt, std::deque<keyType> &edges, std::deque<keyType> *others, ups_txn_t *upsTr);
+
+        /** Implementation of GraphElem::getDegree(EdgeEndType, Transaction&)
+         * operating on ge. */
+        countType getDegree(std::shared_ptr<GraphElem> &ge, EdgeEndType direction, Transaction &tr);
+
+        /** Implementation of GraphElem::getDegree(EdgeEndType)
+         * operating on ge. */
+        countType getDegree(std::shared_ptr<GraphElem> &ge, EdgeEndType direction);
+
+        /** Returns the degree of the node with the given key reading only its
+         * head record. Neither the node nor its edges get marked in the transaction,
+         * but a read-write transaction holding the node is detected. */
+        countType doGetDegree(keyType key, EdgeEndType direction, Transaction &tr);
+
+        /** Implementation of getDegrees. */
+        std::deque<countType> doGetDegrees(const std::deque<std::shared_ptr<GraphElem>> &nodes, EdgeEndType direction, Transaction &tr);
+
         /** Implementation of GraphElem::getEnd(Transaction &tr)
          * operating on the edge identifierd by key. */
         std::shared_ptr<GraphElem> getEnd(std::shared_ptr<GraphElem> &ge, Transaction &tr);
@@ -445,6 +1018,11 @@ namespace udbgraph {
         keyType getFirstFreeKey();
 
         friend class GraphElem;
+        friend class Edge;
+        friend class EdgeCursor;
+        friend class ExtentCursor;
+        friend class FieldCursor;
+        friend class OrderedEdgeCursor;
         friend class Transaction;
     };
 
@@ -560,6 +1138,29 @@ namespace udbgraph {
         friend class GraphElem;
     };
 
+    /** Fixed fields of a head record, used for filtering before reading the
+     * rest of the record chain. */
+    class HeadFields final {
+    public:
+        /** Key of the elem. */
+        keyType key;
+
+        /** Record type of the elem. */
+        RecordType recordType;
+
+        /** Payload type of the elem. */
+        payloadType type;
+
+        /** ACL key of the elem. */
+        keyType aclKey;
+
+        /** Start node of an edge, KEY_INVALID for nodes. */
+        keyType start;
+
+        /** End node of an edge, KEY_INVALID for nodes. */
+        keyType end;
+    };
+
     /** Base class for filtering payloads when retrieving more edges or nodes. This
      * implementation matches everything. */
     class Filter {
@@ -579,6 +1180,22 @@ namespace udbgraph {
         may arrive. */
         virtual bool match(const Payload * const pl) const noexcept { return true; }
 
+        /** First stage of filtering called with the fixed fields of the head record
+         * only. If it returns false, the elem is dropped without reading the rest of
+        its records and deserializing its payload, otherwise match decides. This
+        implementation checks the type returned by getPayloadType. */
+        virtual bool matchHead(const HeadFields &head) const noexcept;
+
+        /** Returns true if the result of match depends only on the payload type
+         * returned by getPayloadType, so the library can evaluate it on indexes
+        without reading the payload. This holds only for Filter and PayloadTypeFilter. */
+        bool matchesByTypeOnly() const noexcept;
+
+        /** Returns the payload type all matching payloads must have, or PT_ANY
+         * if there is no such restriction. If not PT_ANY, edge queries read only
+        the edges of this type. This implementation returns PT_ANY. */
+        virtual payloadType getPayloadType() const noexcept { return PT_ANY; }
+
         /** Returns the static member of the same type matching everyting. */
         static Filter& allpass() { return defaultFilter; }
     };
@@ -600,6 +1217,9 @@ namespace udbgraph {
         if the stored type in this is PT_ANY. */
         virtual bool match(const Payload * const pl) const noexcept { return type == PT_ANY || pl->getType() == type; }
 
+        /** Returns the stored type. */
+        virtual payloadType getPayloadType() const noexcept { return type; }
+
         /** Looks up pt in store. If found, returns a reference to the instance.
          * If not found, inserts it and returns the new reference. This is a convenience
         mechanism for passing PayloadTypeFilters inline without instantiating in a
@@ -607,6 +1227,400 @@ namespace udbgraph {
         static PayloadTypeFilter& get(payloadType pt);
     };
 
+    /** Extracts the weight of an edge for shortest path queries. */
+    class EdgeWeight {
+    private:
+
+        static EdgeWeight defaultWeight;
+
+    public:
+        /** Destructs everything. */
+        virtual ~EdgeWeight() {}
+
+        /** Returns the weight of the edge having the payload pl, which must not
+         * be negative. This base implementation returns 1 for all edges. The
+        implementations in subclasses will have to cast pl to the intended payload
+        type. */
+        virtual double weight(const Payload * const) const { return 1.0; }
+
+        /** Returns the static member of the same type giving 1 for each edge. */
+        static EdgeWeight& unit() { return defaultWeight; }
+    };
+
+    /** Iterates over the edges of a node reading them one by one on demand.
+     * The edge keys are collected in adjacency order at creation, but each edge
+     * is read, filtered and marked in the transaction only when next reaches it.
+    Instances are created by GraphElem::getEdgeCursor. The transaction and the filter
+    must outlive the cursor. */
+    class EdgeCursor final {
+    protected:
+        /** The Database performing the reads, not kept alive by the cursor. */
+        std::weak_ptr<Database> db;
+
+        /** The transaction to read in. */
+        Transaction &tr;
+
+        /** The filter the returned edges must match. */
+        Filter &fltEdge;
+
+        /** Keys of the candidate edges delimited by KEY_INVALID. */
+        std::unique_ptr<keyType[]> keys;
+
+        /** Index of the next key to examine. */
+        size_t position = 0;
+
+        /** Maximum number of edges to return, 0 means unlimited. */
+        size_t limit;
+
+        /** Number of edges returned so far. */
+        size_t returned = 0;
+
+        /** See GraphElem::getEdges. */
+        bool omitFailed;
+
+        /** Called only by Database. Takes ownership of k. */
+        EdgeCursor(std::shared_ptr<Database> d, Transaction &t, Filter &f, keyType *k, size_t lim, bool omit) noexcept :
+            db(d), tr(t), fltEdge(f), keys(k), limit(lim), omitFailed(omit) {}
+
+    public:
+        EdgeCursor(EdgeCursor &&c) = default;
+
+        EdgeCursor(const EdgeCursor &c) = delete;
+
+        EdgeCursor& operator=(const EdgeCursor &c) = delete;
+
+        /** Reads the candidate edges until the first one matching the filter and
+         * returns it after marking it in the transaction. Returns nullptr if there
+        are no more edges or limit is reached. */
+        std::shared_ptr<GraphElem> next();
+
+        friend class Database;
+    };
+
+    /** Iterates over the nodes or edges of a payload type in key order, reading
+     * them one by one on demand. Instances are created by Database::getExtentCursor.
+    The transaction and the filter must outlive the cursor. */
+    class ExtentCursor final {
+    protected:
+        /** Number of keys read from the extent index at once. */
+        static const size_t batchSize = 256;
+
+        /** The Database performing the reads, not kept alive by the cursor. */
+        std::weak_ptr<Database> db;
+
+        /** The transaction to read in. */
+        Transaction &tr;
+
+        /** The payload type to enumerate. */
+        payloadType type;
+
+        /** The filter the returned elems must match. */
+        Filter &flt;
+
+        /** Keys of the actual batch not examined yet. */
+        std::deque<keyType> keys;
+
+        /** The next batch starts at this key. */
+        keyType nextKey = 0;
+
+        /** True after the last batch was read. */
+        bool exhausted = false;
+
+        /** Maximum number of elems to return, 0 means unlimited. */
+        size_t limit;
+
+        /** Number of elems returned so far. */
+        size_t returned = 0;
+
+        /** See GraphElem::getEdges. */
+        bool omitFailed;
+
+        /** Called only by Database. */
+        ExtentCursor(std::shared_ptr<Database> d, Transaction &t, payloadType pt, Filter &f, size_t lim, bool omit) noexcept :
+            db(d), tr(t), type(pt), flt(f), limit(lim), omitFailed(omit) {}
+
+    public:
+        ExtentCursor(ExtentCursor &&c) = default;
+
+        ExtentCursor(const ExtentCursor &c) = delete;
+
+        ExtentCursor& operator=(const ExtentCursor &c) = delete;
+
+        /** Reads the elems until the first one matching the filter and returns it
+         * after marking it in the transaction. Returns nullptr if there are no
+        more elems or limit is reached. */
+        std::shared_ptr<GraphElem> next();
+
+        friend class Database;
+    };
+
+    /** Iterates over the elems of a field index range in value order, reading
+     * them one by one on demand. Instances are created by Database::getFieldCursor.
+    The transaction and the filter must outlive the cursor. */
+    class FieldCursor final {
+    protected:
+        /** Number of keys read from the field index at once. */
+        static const size_t batchSize = 256;
+
+        /** The Database performing the reads, not kept alive by the cursor. */
+        std::weak_ptr<Database> db;
+
+        /** The transaction to read in. */
+        Transaction &tr;
+
+        /** The field index id. */
+        uint16_t indexId;
+
+        /** The range to scan. */
+        FieldRange range;
+
+        /** The filter the returned elems must match. */
+        Filter &flt;
+
+        /** Keys of the actual batch not examined yet. */
+        std::deque<keyType> keys;
+
+        /** The last index entry read, the next batch starts after it. */
+        IndexKey resume;
+
+        /** True after the last batch was read. */
+        bool exhausted = false;
+
+        /** Maximum number of elems to return, 0 means unlimited. */
+        size_t limit;
+
+        /** Number of elems returned so far. */
+        size_t returned = 0;
+
+        /** See GraphElem::getEdges. */
+        bool omitFailed;
+
+        /** Called only by Database. */
+        FieldCursor(std::shared_ptr<Database> d, Transaction &t, uint16_t id, const FieldRange &r, Filter &f, size_t lim, bool omit) :
+            db(d), tr(t), indexId(id), range(r), flt(f), limit(lim), omitFailed(omit) {}
+
+    public:
+        FieldCursor(FieldCursor &&c) = default;
+
+        FieldCursor(const FieldCursor &c) = delete;
+
+        FieldCursor& operator=(const FieldCursor &c) = delete;
+
+        /** Reads the elems until the first one matching the filter and returns it
+         * after marking it in the transaction. Returns nullptr if there are no
+        more elems or limit is reached. */
+        std::shared_ptr<GraphElem> next();
+
+        friend class Database;
+    };
+
+    /** Iterates over the edges of a node in the order of an edge order index,
+     * reading them one by one on demand. Instances are created by
+    GraphElem::getOrderedEdgeCursor. The transaction and the filter must outlive
+    the cursor. */
+    class OrderedEdgeCursor final {
+    protected:
+        /** Number of keys read from the index at once. */
+        static const size_t batchSize = 64;
+
+        /** The Database performing the reads, not kept alive by the cursor. */
+        std::weak_ptr<Database> db;
+
+        /** The transaction to read in. */
+        Transaction &tr;
+
+        /** The edge order index id. */
+        uint16_t indexId;
+
+        /** The node whose edges are returned. */
+        keyType node;
+
+        /** EdgeEndBits of the direction. */
+        uint8_t ends;
+
+        /** The range of sort values to scan. */
+        FieldRange range;
+
+        /** The filter the returned edges must match. */
+        Filter &fltEdge;
+
+        /** Keys of the actual batch not examined yet. */
+        std::deque<keyType> keys;
+
+        /** The last index entry read, the next batch starts after it. */
+        IndexKey resume;
+
+        /** True after the last batch was read. */
+        bool exhausted = false;
+
+        /** Maximum number of edges to return, 0 means unlimited. */
+        size_t limit;
+
+        /** Number of edges returned so far. */
+        size_t returned = 0;
+
+        /** See GraphElem::getEdges. */
+        bool omitFailed;
+
+        /** Called only by Database. */
+        OrderedEdgeCursor(std::shared_ptr<Database> d, Transaction &t, uint16_t id, keyType n, uint8_t e, const FieldRange &r, Filter &f, size_t lim, bool omit) :
+            db(d), tr(t), indexId(id), node(n), ends(e), range(r), fltEdge(f), limit(lim), omitFailed(omit) {}
+
+    public:
+        OrderedEdgeCursor(OrderedEdgeCursor &&c) = default;
+
+        OrderedEdgeCursor(const OrderedEdgeCursor &c) = delete;
+
+        OrderedEdgeCursor& operator=(const OrderedEdgeCursor &c) = delete;
+
+        /** Reads the edges until the first one matching the filter and returns it
+         * after marking it in the transaction. Returns nullptr if there are no
+        more edges or limit is reached. */
+        std::shared_ptr<GraphElem> next();
+
+        friend class Database;
+    };
+
+    /** One step of a breadth-first traversal: the direction of the edges to
+     * follow and the filters for the edges and the reached nodes. The filters
+    must outlive the traversal. */
+    class Hop final {
+    protected:
+        /** Direction of the edges to follow, seen from the actual node. */
+        EdgeEndType direction;
+
+        /** Filter for the followed edges. */
+        Filter &fltEdge;
+
+        /** Filter for the reached nodes. */
+        Filter &fltNode;
+
+    public:
+        /** Stores the parameters. */
+        Hop(EdgeEndType dir, Filter &fe, Filter &fn) noexcept : direction(dir), fltEdge(fe), fltNode(fn) {}
+
+        friend class Database;
+    };
+
+    /** A small graph of node and edge conditions to be found in the database.
+     * The pattern nodes and edges are numbered in the order of addition from 0.
+    The filters must outlive the pattern. */
+    class Pattern final {
+    protected:
+        /** Filters of the pattern nodes. */
+        std::deque<Filter*> nodeFilters;
+
+        /** Pattern node indices at the ends of each pattern edge. */
+        std::deque<std::pair<size_t, size_t>> edgeEnds;
+
+        /** Direction of each pattern edge seen from its first end. */
+        std::deque<EdgeEndType> edgeDirections;
+
+        /** Filters of the pattern edges. */
+        std::deque<Filter*> edgeFilters;
+
+    public:
+        /** Adds a node matching flt.
+        @return its index. */
+        size_t addNode(Filter &flt);
+
+        /** Adds an edge matching flt between the pattern nodes from and to.
+         * The direction is seen from 'from', so EdgeEndType::Out means an edge
+        starting at from and ending at to.
+        @return its index.
+        @throws IllegalArgumentException if the nodes do not exist or are the same. */
+        size_t addEdge(size_t from, size_t to, EdgeEndType direction, Filter &flt);
+
+        /** Returns the number of pattern nodes. */
+        size_t getNodeCount() const noexcept { return nodeFilters.size(); }
+
+        /** Returns the number of pattern edges. */
+        size_t getEdgeCount() const noexcept { return edgeFilters.size(); }
+
+        friend class Database;
+    };
+
+    /** One occurrence of a Pattern. The graph elems are stored at the indices of
+     * the pattern nodes and edges they are bound to. */
+    class PatternMatch final {
+    public:
+        /** Nodes bound to the pattern nodes. */
+        std::deque<std::shared_ptr<GraphElem>> nodes;
+
+        /** Edges bound to the pattern edges. */
+        std::deque<std::shared_ptr<GraphElem>> edges;
+    };
+
+    /** Read-only snapshot of the graph structure in compressed sparse row form
+     * for bulk algorithms, created by Database::buildCSR. Nodes are referred to by
+    their index in nodeKeys. The outgoing edges of node i occupy the positions
+    offsets[i] to offsets[i + 1] - 1 of targets and edgeKeys, ordered by target.
+    Directed edges are stored at their start node, undirected ones at both ends. */
+    class CSRGraph final {
+    public:
+        /** Keys of the nodes including the root, in ascending order. */
+        std::vector<keyType> nodeKeys;
+
+        /** Payload types of the nodes if requested, empty otherwise. */
+        std::vector<payloadType> nodeTypes;
+
+        /** Start positions of the edge lists, one more than the nodes. */
+        std::vector<size_t> offsets;
+
+        /** Node index at the other end of each edge. */
+        std::vector<size_t> targets;
+
+        /** Key of each edge. */
+        std::vector<keyType> edgeKeys;
+
+        /** Payload type of each edge if requested, empty otherwise. */
+        std::vector<payloadType> edgeTypes;
+
+        /** 1 for each directed edge, 0 for undirected ones. */
+        std::vector<uint8_t> directed;
+
+        /** Returns the number of nodes. */
+        size_t getNodeCount() const noexcept { return nodeKeys.size(); }
+
+        /** Returns the index of the node with the given key, or getNodeCount() if not present. */
+        size_t findNode(keyType key) const noexcept;
+
+        /** Empties all arrays. */
+        void clear() noexcept;
+    };
+
+    /** Stores a computed score into a node payload for Database::writeScores. */
+    class ScoreSetter {
+    public:
+        /** Destructs everything. */
+        virtual ~ScoreSetter() {}
+
+        /** Stores value into pl. The implementations will have to cast pl to the
+         * intended payload type.
+        @return true if pl has changed and must be written. */
+        virtual bool set(Payload * const pl, double value) const = 0;
+    };
+
+    /** Result of Database::findOrphans. */
+    class OrphanReport final {
+    public:
+        /** Keys of the nodes not reachable from the root, in ascending order. */
+        std::vector<keyType> nodes;
+
+        /** Keys of the edges having no reachable end, in ascending order. */
+        std::vector<keyType> edges;
+
+        /** Keys of the continuation records not belonging to any record chain,
+         * in ascending order. */
+        std::vector<keyType> strayRecords;
+
+        /** True if the listed records have been erased. */
+        bool removed = false;
+
+        /** Empties the lists. */
+        void clear() noexcept;
+    };
+
     /** A common abstract base class for nodes and edges. This class and subclasses
      * may be used only wrapped in a shared_ptr. Neither this class, nor its subclasses
      * are intended for further dubclassing by the application. */
@@ -757,10 +1771,93 @@ namespace udbgraph {
          * be included considering the given filter. May not be called on edges. */
         void getEdges(QueryResult &res, EdgeEndType direction, Filter &fltEdge, bool omitFailed = true);
 
+        /** Returns a cursor over the edges with given direction and matching fltEdge.
+         * Only the edge keys are collected here, the edges are read one by one as
+        EdgeCursor::next is called, so iteration can stop early without reading the
+        rest. At most limit edges are returned if it is not 0. Each returned edge
+        is marked in the transaction. See getEdges for omitFailed, but here the
+        exception comes from EdgeCursor::next. May not be called on edges. */
+        EdgeCursor getEdgeCursor(EdgeEndType direction, Filter &fltEdge, Transaction &tr, size_t limit = 0, bool omitFailed = true);
+
+        /** Returns the first edge with given direction matching fltEdge, or nullptr
+         * if there is none. Only the edges up to the returned one are read.
+        The function marks the returned edge in the transaction. May not be called on edges. */
+        std::shared_ptr<GraphElem> getFirstEdge(EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = true);
+
+        /** Returns a cursor over the edges with given direction in the order of the
+         * edge order index, see GEFactory::regEdgeOrder. Only the edges of the indexed
+        payload type with a sort value in range are returned, so for example
+        FieldRange::all(true) with limit 50 gives the latest 50 edges by a timestamp
+        without reading the others. May not be called on edges.
+        @throws DatabaseException if the index is unknown. */
+        OrderedEdgeCursor getOrderedEdgeCursor(uint16_t indexId, EdgeEndType direction, const FieldRange &range, Filter &fltEdge,
+            Transaction &tr, size_t limit = 0, bool omitFailed = true);
+
+        /** Performs a breadth-first traversal of at most hops.size() steps from this
+         * node. In step i the edges described by hops[i] are followed from the nodes
+        reached in the previous step, and the nodes matching its node filter and not
+        visited earlier are appended as a new QueryResult into levels. This node is
+        never returned, and neither is the root. Each step reads all its nodes in one
+        batch, and the traversal stops early if a step reaches no new node. So
+        levels.back() is the frontier. The nodes are marked in the transaction as
+        by getNeighbours. See getEdges for omitFailed. May not be called on edges. */
+        void traverse(std::deque<QueryResult> &levels, const std::deque<Hop> &hops, Transaction &tr, bool omitFailed = true);
+
+        /** Performs a breadth-first traversal like the above function using a
+         * temporary transaction. */
+        void traverse(std::deque<QueryResult> &levels, const std::deque<Hop> &hops, bool omitFailed = true);
+
+        /** Finds a path of minimal total weight from this node to target using
+         * Dijkstra's algorithm, following the edges of the given direction matching
+        fltEdge. The edges of each settled node are read in one batch, and the search
+        stops as soon as target is settled. The path is put into path as alternating
+        nodes and edges, beginning with this node and ending with target. If target
+        can not be reached, path remains empty. See getEdges for omitFailed.
+        May not be called on edges.
+        @return the total weight or infinity if there is no path.
+        @throws IllegalArgumentException if weight returns a negative value. */
+        double getShortestPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, Transaction &tr, bool omitFailed = true);
+
+        /** Finds a shortest path like the above function using a temporary transaction. */
+        double getShortestPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, EdgeWeight &weight, bool omitFailed = true);
+
+        /** Returned by getFewestHopsPath if there is no path. */
+        static constexpr size_t NO_PATH = static_cast<size_t>(-1);
+
+        /** Finds a path having the fewest edges from this node to target using
+         * breadth-first search from both ends, always expanding the smaller
+        frontier level in one batch. The edges are read only if fltEdge needs their
+        payload. The path is returned like by getShortestPath. May not be called on edges.
+        @return the number of edges in the path, 0 if target is this node and
+        NO_PATH if target can not be reached. */
+        size_t getFewestHopsPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = true);
+
+        /** Finds a path having the fewest edges like the above function using
+         * a temporary transaction. */
+        size_t getFewestHopsPath(std::deque<std::shared_ptr<GraphElem>> &path, std::shared_ptr<GraphElem> &target, EdgeEndType direction, Filter &fltEdge, bool omitFailed = true);
+
+        /** Finds all occurrences of pattern having its node anchor bound to this node,
+         * and appends them into result. Distinct pattern nodes are bound to distinct
+        nodes and distinct pattern edges to distinct edges, the root is bound only
+        as anchor. The pattern must be connected. The join order is decided
+        during the search: edges closing a cycle are checked first, otherwise the
+        search continues at the bound node having the fewest edges in the direction
+        needed, using the edge counts in its head. The edges of a node and the
+        candidate nodes are read in one batch and at most once per search.
+        See getEdges for omitFailed. May not be called on edges.
+        @throws IllegalArgumentException if anchor is invalid or the pattern is not connected. */
+        void matchPattern(std::deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, Transaction &tr, bool omitFailed = true);
+
+        /** Finds all occurrences of pattern like the above function using a
+         * temporary transaction. */
+        void matchPattern(std::deque<PatternMatch> &result, const Pattern &pattern, size_t anchor, bool omitFailed = true);
+
         /** Collects all neighbouring nodes matching fltNode into res
          * connected by edges of given direction and matching fltEdge.
          * Root node is never included. The function marks all returned nodes
-         * and their edges in the transaction. If omitFailed is set, leaves out
+         * and their edges in the transaction. If fltEdge only checks the payload
+         * type (see Filter::matchesByTypeOnly), the edges are not read and marked,
+         * the neighbours are looked up in the adjacency index. If omitFailed is set, leaves out
          * items causing permission or transaction exception, otherwise throws
          * exception and returns without changing anything. This exception is thrown
          * even if the causing edge would not be included considering the given
@@ -805,6 +1902,87 @@ namespace udbgraph {
          * an IllegalArgumentEception is thrown instead. */
         std::shared_ptr<GraphElem> getEnd();
 
+        /** Collects all edges between this node and other into res with the given
+         * direction seen from this node and matching fltEdge. other may be the root.
+         * The edges are looked up in the edge end index, so only the matching edges
+         * are read. The function marks all returned items in the transaction.
+         * See getEdges for omitFailed. May not be called on edges. */
+        void getEdgesBetween(QueryResult &res, std::shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = true);
+
+        /** Collects all edges between this node and other into res with the given
+         * direction seen from this node and matching fltEdge. other may be the root.
+         * The function uses a temporary transaction and the returned edges will
+         * have state GEState::DK (if no more transactions reference them).
+         * See getEdges for omitFailed. May not be called on edges. */
+        void getEdgesBetween(QueryResult &res, std::shared_ptr<GraphElem> &other, EdgeEndType direction, Filter &fltEdge, bool omitFailed = true);
+
+        /** Returns true if there is at least one edge between this node and other
+         * with the given direction seen from this node. other may be the root.
+         * Only the head records of the nodes and the edge end index are read, no
+         * edge or node gets marked in the transaction, but a node held by a
+        clashing transaction causes TransactionException.
+        May not be called on edges. */
+        bool existsEdge(std::shared_ptr<GraphElem> &other, EdgeEndType direction, Transaction &tr);
+
+        /** Returns true if there is at least one edge between this node and other
+         * with the given direction seen from this node using a temporary transaction.
+         * other may be the root. May not be called on edges. */
+        bool existsEdge(std::shared_ptr<GraphElem> &other, EdgeEndType direction);
+
+        /** Returns true if this node has at least one edge of payload type pt (PT_ANY
+         * for all) with the given direction. Only the first matching adjacency index
+        entry is read besides the head of this node, so a negative answer costs one
+        index lookup per direction, and no edge or node gets marked in the transaction.
+        A node held by a clashing transaction causes TransactionException as for
+        getDegree. May not be called on edges. */
+        bool existsEdgeOfType(EdgeEndType direction, payloadType pt, Transaction &tr);
+
+        /** As existsEdgeOfType above using a temporary transaction. */
+        bool existsEdgeOfType(EdgeEndType direction, payloadType pt);
+
+        /** Returns the number of edges with given direction matching fltEdge. The
+         * edge keys come from the adjacency index. If the filter checks only the
+        payload type (see Filter::matchesByTypeOnly), just the head record of each
+        edge is looked up for the lock and ACL checks, otherwise the edges are read
+        into temporary instances. Neither the edges nor this node get marked in the
+        transaction and no result set is built.
+        Edges held by a clashing transaction are skipped if omitFailed is true,
+        otherwise they cause an exception. May not be called on edges. */
+        size_t countEdges(EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = true);
+
+        /** As countEdges above using a temporary transaction. */
+        size_t countEdges(EdgeEndType direction, Filter &fltEdge, bool omitFailed = true);
+
+        /** Returns true if this node has at least one edge with given direction
+         * matching fltEdge. Works like countEdges but stops at the first match.
+        May not be called on edges. */
+        bool anyEdge(EdgeEndType direction, Filter &fltEdge, Transaction &tr, bool omitFailed = true);
+
+        /** As anyEdge above using a temporary transaction. */
+        bool anyEdge(EdgeEndType direction, Filter &fltEdge, bool omitFailed = true);
+
+        /** Returns the count and sum of the values of the edges of this node with
+         * the given direction, see GEFactory::regAggregate. Only the stored aggregates
+        and the head of this node are read, so no edge gets loaded or marked in the
+        transaction. May not be called on edges.
+        @throws DatabaseException if the index is unknown.
+        @throws TransactionException if this node is held by a clashing transaction. */
+        EdgeAggregate getAggregate(uint16_t indexId, EdgeEndType direction, Transaction &tr);
+
+        /** As getAggregate above using a temporary transaction. */
+        EdgeAggregate getAggregate(uint16_t indexId, EdgeEndType direction);
+
+        /** Returns the number of edges of this node in the given direction.
+         * For EdgeEndType::Any it is the sum of all three. Only the head record
+         * is read, so no edge is loaded and nothing gets marked in the transaction.
+         * Throws exception if the node is held by a clashing transaction.
+         * May not be called on edges. */
+        countType getDegree(EdgeEndType direction, Transaction &tr);
+
+        /** Returns the number of edges of this node in the given direction
+         * using a temporary transaction. May not be called on edges. */
+        countType getDegree(EdgeEndType direction);
+
 protected:
         /** Increments roTransCounter. */
         void incROCnt() noexcept { roTransCounter++; }
@@ -812,9 +1990,15 @@ protected:
         /** Throws exception if the elem is not a node. */
         void assureNode() const;
 
+        /** Returns the fixed fields of the head record for filtering. */
+        HeadFields getHeadFields() const;
+
         /** Thorws exception if the elem is not a node. */
         void assureEdge() const;
 
+        /** Throws exception if the elem is neither a node nor the root. */
+        void assureNodeOrRoot() const;
+
         /** Does the necessary checks before setting ends in recordchain. */
         void checkEnds(RecordType rt1, RecordType rt2, keyType key1, keyType key2) const;
 
@@ -886,6 +2070,10 @@ protected:
 
         void addEdge(FieldPosNode where, keyType key, ups_txn_t *tr);
 
+        /** Adds all the edge keys to the given hash table at once. */
+        void addEdges(FieldPosNode where, const std::deque<keyType> &keys, ups_txn_t *tr);
+
+        friend class Database;
         friend class DirEdge;
         friend class UndirEdge;
     };
@@ -947,6 +2135,12 @@ protected:
         The queue always has the start point at the first place. */
         virtual std::deque<keyType> getConnectedElemsBeforeWrite();
 
+        /** Registers the brand new edge in the edge indexes of the Database. */
+        void indexEdge(ups_txn_t *tr);
+
+        /** Registers the brand new edge in the given hash table of node. */
+        void addToNode(std::shared_ptr<GraphElem> &node, FieldPosNode where, ups_txn_t *tr);
+
     };
 
     /** A general directed edge class represents the actual directed edge types in
@@ -1062,6 +2256,23 @@ protected:
 
         /** Counter holding the next free type ID. */
         static payloadType typeCounter;
+
+        /** Payload types and extractors of the field indexes, the position is the index id. */
+        static std::deque<std::pair<payloadType, std::shared_ptr<FieldExtractor>>> fieldIndexes;
+
+        /** Payload types and extractors of the spatial indexes, the position is the index id. */
+        static std::deque<std::pair<payloadType, std::shared_ptr<GeoExtractor>>> geoIndexes;
+
+        /** Registration data of the vector indexes, the position is the index id. */
+        static std::deque<VectorIndex::Params> vectorIndexes;
+
+        /** Edge payload types and sort value extractors of the edge order indexes, the position is the index id. */
+        static std::deque<std::pair<payloadType, std::shared_ptr<FieldExtractor>>> edgeOrders;
+
+        /** Edge payload types and value extractors of the edge aggregates, the position is the index id. */
+        static std::deque<std::pair<payloadType, std::shared_ptr<ValueExtractor>>> aggregates;
+
+        friend class Database;
     public:
         /** Called in a static instance of class InitStatic to register built-in types. */
         static void initStatic();
@@ -1070,6 +2281,40 @@ protected:
         TheClass::setID(GEFactory::reg(TheClass::create)); */
         static payloadType reg(CreatorFunction classCreator);
 
+        /** Registers a field index over the payloads of type pt. Must be called in the
+         * same order before each Database::create or open, because the index id
+         * determines the database name in the environment. Database::open throws
+         * DatabaseException if the index stored under the name has an other payload
+        type. An index missing from an existing environment is built from all elems
+        of the type when opening.
+        @return the index id to use in Database::findByField and findByFieldRange. */
+        static uint16_t regIndex(payloadType pt, std::shared_ptr<FieldExtractor> extractor);
+
+        /** Registers a spatial index over the payloads of type pt under the same
+         * conditions as regIndex.
+        @return the index id to use in Database::findInBox and findNearest. */
+        static uint16_t regGeoIndex(payloadType pt, std::shared_ptr<GeoExtractor> extractor);
+
+        /** Registers an approximate nearest neighbour index over the vectors of the
+         * payloads of type pt under the same conditions as regIndex.
+        @param maxLinks maximum number of neighbours of an elem on the upper layers of the index graph.
+        @param efConstruction candidate list size when inserting, larger gives a better graph but slower writes.
+        @param efSearch default candidate list size of queries.
+        @return the index id to use in Database::findSimilar. */
+        static uint16_t regVectorIndex(payloadType pt, std::shared_ptr<VectorExtractor> extractor, VectorMetric metric = VectorMetric::EUCLIDEAN,
+            uint16_t maxLinks = 16, uint16_t efConstruction = 100, uint16_t efSearch = 50);
+
+        /** Registers an ordered edge list over the edges of payload type pt, sorted
+         * by the value extractor appends, under the same conditions as regIndex.
+        @return the index id to use in GraphElem::getOrderedEdgeCursor. */
+        static uint16_t regEdgeOrder(payloadType pt, std::shared_ptr<FieldExtractor> extractor);
+
+        /** Registers the count and sum of a value over the edges of payload type pt
+         * for each node, under the same conditions as regIndex.
+        @param extractor gives the value to sum, nullptr for counting only.
+        @return the index id to use in GraphElem::getAggregate. */
+        static uint16_t regAggregate(payloadType pt, std::shared_ptr<ValueExtractor> extractor);
+
         /** Creates a class instance based on the given type. If it is unknown,
          * throws DebugException.
         @param db the Database instance to use with. */
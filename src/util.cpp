@@ -13,12 +13,83 @@ COPYRIGHT COMES HERE
 #endif
 
 #include<iostream>
+#include<system_error>
 
 using namespace std;
 using namespace udbgraph;
 
 bool EndianInfo::littleEndian;
 
+void WorkerPool::loop(uint64_t seen) {
+    unique_lock<mutex> lck(mtx);
+    while(true) {
+        wake.wait(lck, [this, seen]() { return stopping || generation != seen; });
+        if(stopping) {
+            return;
+        }
+        seen = generation;
+        const function<void()> *actual = job;
+        lck.unlock();
+        (*actual)();
+        lck.lock();
+        if(--running == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+void WorkerPool::stop() noexcept {
+    {
+        lock_guard<mutex> lck(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto &thr : threads) {
+        thr.join();
+    }
+    threads.clear();
+    stopping = false;
+}
+
+void WorkerPool::resize(size_t n) {
+    lock_guard<mutex> runLck(runMtx);
+    stop();
+    threads.reserve(n);
+    try {
+        for(size_t i = 0; i < n; i++) {
+            threads.emplace_back(&WorkerPool::loop, this, generation);
+        }
+    }
+    catch(system_error &se) {
+        // go on with the threads already started
+    }
+}
+
+size_t WorkerPool::size() const {
+    lock_guard<mutex> runLck(runMtx);
+    return threads.size();
+}
+
+void WorkerPool::run(const function<void()> &work) {
+    lock_guard<mutex> runLck(runMtx);
+    if(threads.empty()) {
+        work();
+        return;
+    }
+    {
+        lock_guard<mutex> lck(mtx);
+        job = &work;
+        running = threads.size();
+        generation++;
+    }
+    wake.notify_all();
+    // the calling thread works as well
+    work();
+    unique_lock<mutex> lck(mtx);
+    done.wait(lck, [this]() { return running == 0; });
+    job = nullptr;
+}
+
 void EndianInfo::initStatic() noexcept {
     union {
         uint32_t i;
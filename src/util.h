@@ -9,6 +9,10 @@ COPYRIGHT COMES HERE
 
 #include<unordered_map>
 #include<mutex>
+#include<vector>
+#include<thread>
+#include<functional>
+#include<condition_variable>
 
 #if USE_NVWA == 1
 #include"debug_new.h"
@@ -119,6 +123,68 @@ namespace udbgraph {
         static bool isLittle() { return littleEndian; }
     };
 
+    /** A set of threads kept alive between jobs, so running a job in parallel
+     * costs no thread creation. Jobs started from more threads at once run one
+     * after the other. */
+    class WorkerPool final {
+    protected:
+        /** The threads of the pool, not including the caller of run. */
+        std::vector<std::thread> threads;
+
+        /** Serializes run, resize and size, held during the whole job. */
+        mutable std::mutex runMtx;
+
+        /** Guards the fields below. */
+        std::mutex mtx;
+
+        /** Signals a new job or stopping to the threads. */
+        std::condition_variable wake;
+
+        /** Signals the caller of run that the last thread has finished the job. */
+        std::condition_variable done;
+
+        /** The actual job. */
+        const std::function<void()> *job = nullptr;
+
+        /** Incremented for each job, so the threads know if they have run it. */
+        uint64_t generation = 0;
+
+        /** Number of threads still running the actual job. */
+        size_t running = 0;
+
+        /** True while the threads are being stopped. */
+        bool stopping = false;
+
+        /** The loop of each thread waiting for and running the jobs. */
+        void loop(uint64_t seen);
+
+        /** Stops and joins all threads, runMtx must be held or no job may run. */
+        void stop() noexcept;
+
+    public:
+        WorkerPool() noexcept {}
+
+        WorkerPool(const WorkerPool &p) = delete;
+
+        WorkerPool& operator=(const WorkerPool &p) = delete;
+
+        /** Stops the threads. */
+        ~WorkerPool() noexcept { stop(); }
+
+        /** Replaces the threads by n new ones after the running job if any has
+         * finished. If the system cannot start all of them, the pool goes on with
+         * the threads already started. */
+        void resize(size_t n);
+
+        /** Returns the number of threads in the pool. */
+        size_t size() const;
+
+        /** Runs work on all threads of the pool and on the calling thread, and
+         * returns when all of them have finished. If an other job is running,
+         * waits for it to finish first. work must not throw. */
+        void run(const std::function<void()> &work);
+    };
+
     /** Class template for automatic array deallocation. */
     template<typename T>
     class AutoDeleter final {